@@ -1,13 +1,50 @@
 #include <string>
+#include <string_view>
 #include <iostream>
+#include <fstream>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory_resource>
+#include <unordered_map>
+#include <cstdint>
+#include <optional>
+#include <new>
+#include <utility>
+#include <concepts>
+#include <type_traits>
+#include <stdexcept>
+#include <charconv>
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <cstdio>
+#include <unistd.h>
 #include <gtest/gtest.h>
+#include "bench.h"
 
 
 class Person;
-class PersonBuilderBase;
-class PersonBuilder;
-class PersonAddressBuilder;
-class PersonJobBuilder;
+class PersonView;
+class PersonArena;
+class PersonRow;
+class PersonTable;
+template <typename P> class BasicPersonBuilderBase;
+template <typename P> class BasicPersonBuilder;
+template <typename P> class BasicPersonAddressBuilder;
+template <typename P> class BasicPersonJobBuilder;
+
+using PersonBuilder = BasicPersonBuilder<Person>;
+using PersonAddressBuilder = BasicPersonAddressBuilder<Person>;
+using PersonJobBuilder = BasicPersonJobBuilder<Person>;
+
+// Bulk import: the same facets, but field bytes are copied into a
+// PersonArena and the product is a PersonView over them.
+using PersonViewBuilder = BasicPersonBuilder<PersonView>;
+
+// Analytics: the facets write each field straight into a PersonTable row.
+using PersonRowBuilder = BasicPersonBuilder<PersonRow>;
 
 class Person {
     // address
@@ -18,13 +55,16 @@ class Person {
     int annual_income = 0;
     Person() { };
 
-    friend class PersonBuilder;
-    friend class PersonAddressBuilder;
-    friend class PersonJobBuilder;
+    template <typename> friend class BasicPersonBuilderBase;
+    template <typename> friend class BasicPersonBuilder;
+    template <typename> friend class BasicPersonAddressBuilder;
+    template <typename> friend class BasicPersonJobBuilder;
+    friend class ReusablePersonBuilder;
     friend std::ostream& operator<<(std::ostream& os, const Person& person);
 
 public:
     static PersonBuilder create();
+    static PersonViewBuilder create(PersonArena& arena);
 
     // Getter methods for gtest
     const std::string_view get_street_address() const { return street_address; }
@@ -35,75 +75,407 @@ public:
     int get_annual_income() const { return annual_income; }
 };
 
-class PersonBuilderBase {
+// Append-only storage for field bytes. Views handed out stay valid until
+// the arena is destroyed; nothing is freed individually.
+class PersonArena {
+    std::pmr::monotonic_buffer_resource bytes;
+    size_t used = 0;
+
+public:
+    explicit PersonArena(size_t initial_size = 1 << 20) : bytes(initial_size) { }
+    PersonArena(const PersonArena&) = delete;
+    PersonArena& operator=(const PersonArena&) = delete;
+
+    std::string_view store(std::string_view s) {
+        if (s.empty()) return {};
+        auto* p = static_cast<char*>(bytes.allocate(s.size(), 1));
+        std::memcpy(p, s.data(), s.size());
+        used += s.size();
+        return {p, s.size()};
+    }
+
+    size_t bytes_used() const { return used; }
+};
+
+// A Person whose fields view bytes in a PersonArena.
+class PersonView {
+    std::string_view street_address, post_code, city;
+    std::string_view company_name, position;
+    int annual_income = 0;
+
+    template <typename> friend class BasicPersonBuilderBase;
+    template <typename> friend class BasicPersonBuilder;
+    template <typename> friend class BasicPersonAddressBuilder;
+    template <typename> friend class BasicPersonJobBuilder;
+    friend class PersonTable;
+
+public:
+    std::string_view get_street_address() const { return street_address; }
+    std::string_view get_post_code() const { return post_code; }
+    std::string_view get_city() const { return city; }
+    std::string_view get_company_name() const { return company_name; }
+    std::string_view get_position() const { return position; }
+    int get_annual_income() const { return annual_income; }
+};
+
+enum class PersonField : uint8_t { street_address, post_code, city, company_name, position, annual_income };
+
+// One field of one PersonTable row.
+struct PersonCell {
+    PersonTable* table;
+    uint32_t row;
+    PersonField field;
+};
+
+// What a PersonRowBuilder fills in: cells that forward to the table.
+class PersonRow {
+    PersonCell street_address, post_code, city;
+    PersonCell company_name, position;
+    PersonCell annual_income;
+
+    template <typename> friend class BasicPersonBuilderBase;
+    template <typename> friend class BasicPersonAddressBuilder;
+    template <typename> friend class BasicPersonJobBuilder;
+
+public:
+    PersonRow(PersonTable& table, uint32_t row)
+        : street_address{&table, row, PersonField::street_address},
+          post_code{&table, row, PersonField::post_code},
+          city{&table, row, PersonField::city},
+          company_name{&table, row, PersonField::company_name},
+          position{&table, row, PersonField::position},
+          annual_income{&table, row, PersonField::annual_income} { }
+
+    uint32_t index() const { return street_address.row; }
+};
+
+// What a text field can be set from: literals, string_views and
+// std::strings, which are moved in when passed as rvalues.
+template <typename S>
+concept text_argument = std::convertible_to<S, std::string_view>;
+
+template <typename P>
+class BasicPersonBuilderBase {
 protected:
-    Person& person;
-    explicit PersonBuilderBase(Person& person) : person(person) { }
+    P& person;
+    PersonArena* arena; // only used when building views
+    bool reusable;      // stage of a ReusablePersonBuilder: keep its buffers
+    explicit BasicPersonBuilderBase(P& person, PersonArena* arena = nullptr, bool reusable = false)
+        : person(person), arena(arena), reusable(reusable) { }
+
+    // Empties every field, keeping the strings' buffers.
+    void clear_fields() requires std::same_as<P, Person> {
+        person.street_address.clear();
+        person.post_code.clear();
+        person.city.clear();
+        person.company_name.clear();
+        person.position.clear();
+        person.annual_income = 0;
+    }
+
+    // One allocation at most: rvalue strings are moved in, anything else is
+    // assigned, reusing the field's buffer when it is big enough.
+    template <typename S>
+    void set(std::string& field, S&& value) {
+        if constexpr (std::is_same_v<S, std::string>) field = std::move(value);
+        else field.assign(std::string_view(value));
+    }
+    void set(std::string_view& field, std::string_view value) { field = arena->store(value); }
+    void set(int& field, int value) { field = value; }
+    void set(PersonCell cell, std::string_view value);
+    void set(PersonCell cell, int value);
 
 public:
-    operator Person() { return std::move(person); }     // implicit conversion
-    // Person build() && { return std::move(person); }  // explicit conversion
+    // Both hand the product over and leave the builder, and every facet
+    // sharing it, empty: nothing leaks from one record into the next. A
+    // reusable builder's facets copy the record out instead, so the staged
+    // buffers survive for the next record.
+    operator P() {                                        // implicit conversion
+        if constexpr (std::same_as<P, Person>) {
+            if (reusable) {
+                P out = person;
+                clear_fields();
+                return out;
+            }
+        }
+        return std::exchange(person, P());
+    }
+    P build() && { return std::exchange(person, P()); }   // explicit conversion
 
     // builder facets
-    PersonAddressBuilder lives() const;
-    PersonJobBuilder works() const;
+    BasicPersonAddressBuilder<P> lives() const;
+    BasicPersonJobBuilder<P> works() const;
 };
 
-class PersonBuilder : public PersonBuilderBase {
-    Person p; // object being built
+template <typename P>
+class BasicPersonBuilder : public BasicPersonBuilderBase<P> {
+    P p; // object being built
 
 public:
-    PersonBuilder() : PersonBuilderBase(p) { }
+    BasicPersonBuilder() : BasicPersonBuilderBase<P>(p) { }
+    explicit BasicPersonBuilder(const P& product) : BasicPersonBuilderBase<P>(p), p(product) { }
+    explicit BasicPersonBuilder(PersonArena& arena) : BasicPersonBuilderBase<P>(p, &arena) { }
 };
 
-class PersonAddressBuilder : public PersonBuilderBase {
-    typedef PersonAddressBuilder self;
+template <typename P>
+class BasicPersonAddressBuilder : public BasicPersonBuilderBase<P> {
+    typedef BasicPersonAddressBuilder self;
 
 public:
-    explicit PersonAddressBuilder(Person& person) : PersonBuilderBase(person) { }
-    self& at(const std::string& street_address) {
-        person.street_address = street_address;
+    explicit BasicPersonAddressBuilder(P& person, PersonArena* arena = nullptr, bool reusable = false)
+        : BasicPersonBuilderBase<P>(person, arena, reusable) { }
+    template <text_argument S>
+    self& at(S&& street_address) {
+        this->set(this->person.street_address, std::forward<S>(street_address));
         return *this;
     }
-    self& with_postcode(const std::string& post_code) {
-        person.post_code = post_code;
+    template <text_argument S>
+    self& with_postcode(S&& post_code) {
+        this->set(this->person.post_code, std::forward<S>(post_code));
         return *this;
     }
-    self& in(const std::string& city) {
-        person.city = city;
+    template <text_argument S>
+    self& in(S&& city) {
+        this->set(this->person.city, std::forward<S>(city));
         return *this;
     }
 };
 
-class PersonJobBuilder : public PersonBuilderBase {
-    typedef PersonJobBuilder self;
+template <typename P>
+class BasicPersonJobBuilder : public BasicPersonBuilderBase<P> {
+    typedef BasicPersonJobBuilder self;
 
 public:
-    explicit PersonJobBuilder(Person& person) : PersonBuilderBase(person) { }
-    self& at(const std::string& company_name) {
-        person.company_name = company_name;
+    explicit BasicPersonJobBuilder(P& person, PersonArena* arena = nullptr, bool reusable = false)
+        : BasicPersonBuilderBase<P>(person, arena, reusable) { }
+    template <text_argument S>
+    self& at(S&& company_name) {
+        this->set(this->person.company_name, std::forward<S>(company_name));
         return *this;
     }
-    self& as_a(const std::string& position) {
-        person.position = position;
+    template <text_argument S>
+    self& as_a(S&& position) {
+        this->set(this->person.position, std::forward<S>(position));
         return *this;
     }
     self& earning(int annual_income) {
-        person.annual_income = annual_income;
+        this->set(this->person.annual_income, annual_income);
         return *this;
     }
 };
 
+// Builds record after record from one set of field buffers. Setters assign
+// into buffers that keep their capacity; build_into() assigns the record
+// into `out` (reusing out's buffers as well) and clears the stage for the
+// next one. Finish each record with build() or build_into(); call
+// validate() first to apply the import rules below. There is no implicit
+// conversion: it would hand over the staged buffers.
+class ReusablePersonBuilder : public BasicPersonBuilderBase<Person> {
+    Person staged;
+
+public:
+    ReusablePersonBuilder() : BasicPersonBuilderBase<Person>(staged, nullptr, true) { }
+    operator Person() = delete;
+
+    Person build() {
+        Person out;
+        build_into(out);
+        return out;
+    }
+
+    void build_into(Person& out) {
+        out.street_address.assign(staged.street_address);
+        out.post_code.assign(staged.post_code);
+        out.city.assign(staged.city);
+        out.company_name.assign(staged.company_name);
+        out.position.assign(staged.position);
+        out.annual_income = staged.annual_income;
+        clear();
+    }
+
+    void clear() { clear_fields(); }
+
+    // Opt-in checks for imported records. Throws std::invalid_argument,
+    // keeping the staged record, if one fails.
+    void validate() const {
+        if (staged.annual_income < 0) throw std::invalid_argument("annual income is negative");
+        if (staged.company_name.empty() && (!staged.position.empty() || staged.annual_income != 0))
+            throw std::invalid_argument("job details without a company");
+        if (staged.city.empty() && !staged.post_code.empty())
+            throw std::invalid_argument("post code without a city");
+    }
+};
+
 PersonBuilder Person::create() {
     return PersonBuilder();
 }
 
-PersonAddressBuilder PersonBuilderBase::lives() const {
-    return PersonAddressBuilder(person);
+PersonViewBuilder Person::create(PersonArena& arena) {
+    return PersonViewBuilder(arena);
+}
+
+template <typename P>
+BasicPersonAddressBuilder<P> BasicPersonBuilderBase<P>::lives() const {
+    return BasicPersonAddressBuilder<P>(person, arena, reusable);
+}
+
+template <typename P>
+BasicPersonJobBuilder<P> BasicPersonBuilderBase<P>::works() const {
+    return BasicPersonJobBuilder<P>(person, arena, reusable);
+}
+
+// Column store for analytical queries over many persons. City, company
+// and position are dictionary-encoded (rows hold 32-bit codes, code 0 is
+// the empty string); annual_income is one contiguous int column. The
+// query kernels are plain branch-free loops over those columns so the
+// compiler can vectorize them.
+class PersonTable {
+public:
+    using code_type = uint32_t;
+
+    class Dictionary {
+        std::vector<std::string_view> values{std::string_view{}};
+        std::unordered_map<std::string_view, code_type> codes{{std::string_view{}, 0}};
+
+    public:
+        code_type encode(std::string_view value, PersonArena& bytes) {
+            auto it = codes.find(value);
+            if (it != codes.end()) return it->second;
+            auto code = static_cast<code_type>(values.size());
+            values.push_back(bytes.store(value));
+            codes.emplace(values.back(), code);
+            return code;
+        }
+        std::optional<code_type> find(std::string_view value) const {
+            auto it = codes.find(value);
+            if (it == codes.end()) return std::nullopt;
+            return it->second;
+        }
+        std::string_view operator[](code_type code) const { return values[code]; }
+        size_t size() const { return values.size(); }
+    };
+
+    PersonRowBuilder append() {
+        auto row = static_cast<uint32_t>(street_addresses.size());
+        street_addresses.emplace_back();
+        post_codes.emplace_back();
+        cities.push_back(0);
+        company_names.push_back(0);
+        positions.push_back(0);
+        incomes.push_back(0);
+        return PersonRowBuilder(PersonRow(*this, row));
+    }
+
+    void set(uint32_t row, PersonField field, std::string_view value) {
+        switch (field) {
+        case PersonField::street_address: street_addresses[row] = bytes.store(value); break;
+        case PersonField::post_code: post_codes[row] = bytes.store(value); break;
+        case PersonField::city: cities[row] = city_dictionary.encode(value, bytes); break;
+        case PersonField::company_name: company_names[row] = company_dictionary.encode(value, bytes); break;
+        case PersonField::position: positions[row] = position_dictionary.encode(value, bytes); break;
+        case PersonField::annual_income: throw std::invalid_argument("annual_income is not a string field");
+        }
+    }
+    void set(uint32_t row, PersonField field, int value) {
+        if (field != PersonField::annual_income) throw std::invalid_argument("only annual_income is an int field");
+        incomes[row] = value;
+    }
+
+    size_t size() const { return incomes.size(); }
+    PersonView operator[](size_t row) const {
+        PersonView p;
+        p.street_address = street_addresses[row];
+        p.post_code = post_codes[row];
+        p.city = city_dictionary[cities[row]];
+        p.company_name = company_dictionary[company_names[row]];
+        p.position = position_dictionary[positions[row]];
+        p.annual_income = incomes[row];
+        return p;
+    }
+
+    // The dictionary-encoded columns; field must be city, company_name or
+    // position, anything else throws std::invalid_argument.
+    const std::vector<code_type>& codes(PersonField field) const { return column(field).first; }
+    const Dictionary& dictionary(PersonField field) const { return column(field).second; }
+    const std::vector<int>& annual_incomes() const { return incomes; }
+
+    // Rows per code of `field`, indexed by code.
+    std::vector<uint64_t> count_by(PersonField field) const {
+        const auto& keys = codes(field);
+        std::vector<uint64_t> counts(dictionary(field).size());
+        for (code_type key : keys) ++counts[key];
+        return counts;
+    }
+
+    // Sum of annual_income per code of `field`, indexed by code.
+    std::vector<int64_t> sum_income_by(PersonField field) const {
+        const auto& keys = codes(field);
+        std::vector<int64_t> sums(dictionary(field).size());
+        for (size_t i = 0; i < keys.size(); ++i) sums[keys[i]] += incomes[i];
+        return sums;
+    }
+
+    // Rows whose `field` equals value, in row order.
+    std::vector<uint32_t> rows_where(PersonField field, std::string_view value) const {
+        auto key = dictionary(field).find(value);
+        if (!key) return {};
+        return select(codes(field), [k = *key](code_type c) { return c == k; });
+    }
+
+    std::vector<uint32_t> rows_earning_at_least(int income) const {
+        return select(incomes, [income](int v) { return v >= income; });
+    }
+
+    int64_t sum_income() const {
+        int64_t sum = 0;
+        for (int v : incomes) sum += v;
+        return sum;
+    }
+
+    int64_t sum_income(const std::vector<uint32_t>& rows) const {
+        int64_t sum = 0;
+        for (uint32_t row : rows) sum += incomes[row];
+        return sum;
+    }
+
+private:
+    PersonArena bytes;
+    std::vector<std::string_view> street_addresses, post_codes;
+    std::vector<code_type> cities, company_names, positions;
+    std::vector<int> incomes;
+    Dictionary city_dictionary, company_dictionary, position_dictionary;
+
+    std::pair<const std::vector<code_type>&, const Dictionary&> column(PersonField field) const {
+        switch (field) {
+        case PersonField::company_name: return {company_names, company_dictionary};
+        case PersonField::position: return {positions, position_dictionary};
+        case PersonField::city: return {cities, city_dictionary};
+        default: throw std::invalid_argument("field is not dictionary-encoded");
+        }
+    }
+
+    // Branch-free selection: always write the row, advance when it matches.
+    template <typename T, typename Pred>
+    static std::vector<uint32_t> select(const std::vector<T>& column, Pred matches) {
+        std::vector<uint32_t> rows(column.size() + 1);
+        size_t n = 0;
+        for (size_t i = 0; i < column.size(); ++i) {
+            rows[n] = static_cast<uint32_t>(i);
+            n += matches(column[i]);
+        }
+        rows.resize(n);
+        return rows;
+    }
+};
+
+template <typename P>
+void BasicPersonBuilderBase<P>::set(PersonCell cell, std::string_view value) {
+    cell.table->set(cell.row, cell.field, value);
 }
 
-PersonJobBuilder PersonBuilderBase::works() const {
-    return PersonJobBuilder(person);
+template <typename P>
+void BasicPersonBuilderBase<P>::set(PersonCell cell, int value) {
+    cell.table->set(cell.row, cell.field, value);
 }
 
 std::ostream& operator<<(std::ostream& os, const Person& p) {
@@ -117,6 +489,308 @@ std::ostream& operator<<(std::ostream& os, const Person& p) {
     return os;
 }
 
+// Serialized persons. Both formats stream through the buffers below and
+// are read back through a ReusablePersonBuilder without validate(), so any
+// Person the writers accept reads back unchanged.
+//
+// Binary: an 8-byte magic, then per person five text fields, each a LEB128
+// length followed by its bytes, and annual_income as 4 bytes in host order.
+// CSV: a header line, then one RFC 4180 line per person; fields holding a
+// comma, quote or line break are quoted with quotes doubled.
+constexpr char person_binary_magic[8] = {'P', 'E', 'R', 'S', 'O', 'N', '\x01', '\n'};
+constexpr std::string_view person_csv_header = "street_address,post_code,city,company_name,position,annual_income\n";
+
+// Collects output and writes it to the file in `limit`-byte chunks.
+class PersonOutputBuffer {
+    std::ofstream file;
+    std::string data;
+    size_t limit;
+
+public:
+    explicit PersonOutputBuffer(const std::string& path, size_t limit = 1 << 20)
+        : file(path, std::ios::binary | std::ios::trunc), limit(limit) {
+        if (!file) throw std::runtime_error("cannot create " + path);
+        data.reserve(limit + 4096);
+    }
+    PersonOutputBuffer(const PersonOutputBuffer&) = delete;
+    PersonOutputBuffer& operator=(const PersonOutputBuffer&) = delete;
+    // Call flush() to see write errors; the destructor can only swallow them.
+    ~PersonOutputBuffer() {
+        try {
+            flush();
+        } catch (const std::exception&) {
+        }
+    }
+
+    std::string& bytes() { return data; }
+    void record_done() {
+        if (data.size() >= limit) flush();
+    }
+    // Throws std::runtime_error, keeping the unwritten bytes, if the file
+    // can't take them (e.g. a full disk).
+    void flush() {
+        file.write(data.data(), static_cast<std::streamsize>(data.size()));
+        file.flush();
+        if (!file) throw std::runtime_error("cannot write person file");
+        data.clear();
+    }
+};
+
+// A window over the file for the parsers to consume from, refilled (and
+// grown, for records longer than the buffer) on demand.
+class PersonInputBuffer {
+    std::ifstream file;
+    std::vector<char> data;
+    size_t begin = 0, end = 0;
+
+public:
+    explicit PersonInputBuffer(const std::string& path, size_t size = 1 << 20)
+        : file(path, std::ios::binary), data(size) {
+        if (!file) throw std::runtime_error("cannot open " + path);
+    }
+
+    std::string_view window() const { return {data.data() + begin, end - begin}; }
+    void consume(size_t n) { begin += n; }
+
+    // Moves what's left to the front and reads more; false at end of file.
+    bool refill() {
+        std::memmove(data.data(), data.data() + begin, end - begin);
+        end -= begin;
+        begin = 0;
+        if (end == data.size()) data.resize(data.size() * 2);
+        file.read(data.data() + end, static_cast<std::streamsize>(data.size() - end));
+        end += static_cast<size_t>(file.gcount());
+        return file.gcount() > 0;
+    }
+};
+
+// The parsed fields of one record; the views point into the input window
+// or into unescaped copies.
+struct PersonFields {
+    std::string_view text[5];
+    int annual_income = 0;
+};
+
+// Reads records with Parser (which returns the bytes consumed, or 0 if the
+// window ends mid-record) and builds them through a ReusablePersonBuilder.
+template <typename Parser>
+class PersonRecordReader {
+    PersonInputBuffer in;
+    Parser parse;
+    ReusablePersonBuilder builder;
+
+public:
+    explicit PersonRecordReader(const std::string& path) : in(path) { parse.header(in); }
+
+    // False at a clean end of file; throws std::runtime_error on a
+    // truncated or malformed record (std::bad_alloc passes through).
+    bool read(Person& out) {
+        try {
+            return read_record(out);
+        } catch (const std::runtime_error&) {
+            throw;
+        } catch (const std::bad_alloc&) {
+            throw;
+        } catch (const std::exception& e) {
+            builder.clear();
+            throw std::runtime_error(std::string("bad person record: ") + e.what());
+        }
+    }
+
+private:
+    bool read_record(Person& out) {
+        PersonFields fields;
+        size_t used;
+        bool more = true;
+        while ((used = parse(in.window(), !more, fields)) == 0) {
+            if (!more) {
+                if (in.window().empty()) return false;
+                throw std::runtime_error("truncated person record");
+            }
+            more = in.refill();
+        }
+        builder.lives().at(fields.text[0]).with_postcode(fields.text[1]).in(fields.text[2])
+               .works().at(fields.text[3]).as_a(fields.text[4]).earning(fields.annual_income);
+        builder.build_into(out);
+        in.consume(used);
+        return true;
+    }
+};
+
+class PersonBinaryWriter {
+    PersonOutputBuffer out;
+
+    void put_text(std::string& bytes, std::string_view s) {
+        for (size_t n = s.size(); ; n >>= 7) {
+            if (n < 0x80) {
+                bytes.push_back(static_cast<char>(n));
+                break;
+            }
+            bytes.push_back(static_cast<char>((n & 0x7f) | 0x80));
+        }
+        bytes.append(s);
+    }
+
+public:
+    explicit PersonBinaryWriter(const std::string& path) : out(path) {
+        out.bytes().append(person_binary_magic, sizeof(person_binary_magic));
+    }
+
+    void write(const Person& p) {
+        std::string& bytes = out.bytes();
+        put_text(bytes, p.get_street_address());
+        put_text(bytes, p.get_post_code());
+        put_text(bytes, p.get_city());
+        put_text(bytes, p.get_company_name());
+        put_text(bytes, p.get_position());
+        int income = p.get_annual_income();
+        bytes.append(reinterpret_cast<const char*>(&income), sizeof(income));
+        out.record_done();
+    }
+
+    void flush() { out.flush(); }
+};
+
+struct PersonBinaryParser {
+    void header(PersonInputBuffer& in) {
+        while (in.window().size() < sizeof(person_binary_magic) && in.refill()) { }
+        if (in.window().substr(0, sizeof(person_binary_magic))
+            != std::string_view(person_binary_magic, sizeof(person_binary_magic)))
+            throw std::runtime_error("not a binary person file");
+        in.consume(sizeof(person_binary_magic));
+    }
+
+    size_t operator()(std::string_view w, bool, PersonFields& fields) const {
+        size_t pos = 0;
+        for (auto& text : fields.text) {
+            uint64_t len = 0;
+            for (int shift = 0; ; shift += 7) {
+                if (pos == w.size()) return 0;
+                if (shift > 56) throw std::runtime_error("bad person field length");
+                auto byte = static_cast<uint8_t>(w[pos++]);
+                len |= uint64_t{byte & 0x7fu} << shift;
+                if (!(byte & 0x80)) break;
+            }
+            if (w.size() - pos < len) return 0;
+            text = w.substr(pos, len);
+            pos += len;
+        }
+        if (w.size() - pos < sizeof(int)) return 0;
+        std::memcpy(&fields.annual_income, w.data() + pos, sizeof(int));
+        return pos + sizeof(int);
+    }
+};
+
+using PersonBinaryReader = PersonRecordReader<PersonBinaryParser>;
+
+class PersonCsvWriter {
+    PersonOutputBuffer out;
+
+    static void put_text(std::string& bytes, std::string_view s) {
+        auto special = [](char c) { return c == ',' || c == '"' || c == '\r' || c == '\n'; };
+        if (std::none_of(s.begin(), s.end(), special)) {
+            bytes.append(s);
+            return;
+        }
+        bytes.push_back('"');
+        for (char c : s) {
+            if (c == '"') bytes.push_back('"');
+            bytes.push_back(c);
+        }
+        bytes.push_back('"');
+    }
+
+public:
+    explicit PersonCsvWriter(const std::string& path) : out(path) { out.bytes().append(person_csv_header); }
+
+    void write(const Person& p) {
+        std::string& bytes = out.bytes();
+        put_text(bytes, p.get_street_address());
+        bytes.push_back(',');
+        put_text(bytes, p.get_post_code());
+        bytes.push_back(',');
+        put_text(bytes, p.get_city());
+        bytes.push_back(',');
+        put_text(bytes, p.get_company_name());
+        bytes.push_back(',');
+        put_text(bytes, p.get_position());
+        bytes.push_back(',');
+        char digits[16];
+        auto [end, ec] = std::to_chars(digits, digits + sizeof(digits), p.get_annual_income());
+        bytes.append(digits, end).push_back('\n');
+        out.record_done();
+    }
+
+    void flush() { out.flush(); }
+};
+
+struct PersonCsvParser {
+    std::string unquoted[6]; // quoted fields, unescaped; reused between records
+
+    void header(PersonInputBuffer& in) {
+        while (in.window().size() < person_csv_header.size() && in.refill()) { }
+        if (!in.window().starts_with(person_csv_header)) throw std::runtime_error("not a person CSV file");
+        in.consume(person_csv_header.size());
+    }
+
+    // At end of file the window's end also ends the last line.
+    size_t operator()(std::string_view w, bool at_end, PersonFields& fields) {
+        if (w.empty()) return 0;
+        size_t pos = 0;
+        std::string_view values[6];
+        for (size_t f = 0; f < 6; ++f) {
+            if (pos < w.size() && w[pos] == '"') {
+                std::string& s = unquoted[f];
+                s.clear();
+                for (++pos; ; ++pos) {
+                    if (pos == w.size()) return 0;
+                    if (w[pos] == '"') {
+                        if (pos + 1 == w.size()) {
+                            if (!at_end) return 0;
+                        } else if (w[pos + 1] == '"') {
+                            s.push_back('"');
+                            ++pos;
+                            continue;
+                        }
+                        ++pos;
+                        break;
+                    }
+                    s.push_back(w[pos]);
+                }
+                values[f] = s;
+            } else {
+                size_t stop = pos;
+                while (stop < w.size() && w[stop] != ',' && w[stop] != '\n' && w[stop] != '\r') ++stop;
+                if (stop == w.size()) {
+                    if (!at_end) return 0;
+                    stop = w.size();
+                }
+                values[f] = w.substr(pos, stop - pos);
+                pos = stop;
+            }
+            char expected = f < 5 ? ',' : '\n';
+            if (pos < w.size() && w[pos] == '\r' && f == 5) ++pos;
+            if (pos == w.size()) {
+                if (!at_end || f < 5) return at_end ? bad_record() : 0;
+            } else if (w[pos] != expected) {
+                return bad_record();
+            } else {
+                ++pos;
+            }
+        }
+        for (size_t f = 0; f < 5; ++f) fields.text[f] = values[f];
+        auto income = values[5];
+        auto [end, ec] = std::from_chars(income.data(), income.data() + income.size(), fields.annual_income);
+        if (ec != std::errc() || end != income.data() + income.size()) return bad_record();
+        return pos;
+    }
+
+private:
+    static size_t bad_record() { throw std::runtime_error("malformed person CSV record"); }
+};
+
+using PersonCsvReader = PersonRecordReader<PersonCsvParser>;
+
 TEST(PersonBuilderTest, BuildPersonWithAddressAndJob) {
     Person p = Person::create()
                 .lives()
@@ -177,6 +851,511 @@ TEST(PersonBuilderTest, BuildEmptyPerson) {
     EXPECT_EQ(p.get_annual_income(), 0);
 }
 
+// Heap allocations made on this thread while an AllocationCounter is alive,
+// for the allocation tests and benchmark; elsewhere operator new just calls
+// malloc.
+static thread_local size_t* allocation_counter = nullptr;
+
+class AllocationCounter {
+    size_t allocations = 0;
+    size_t* outer;
+
+public:
+    AllocationCounter() : outer(std::exchange(allocation_counter, &allocations)) { }
+    ~AllocationCounter() { allocation_counter = outer; }
+    AllocationCounter(const AllocationCounter&) = delete;
+    AllocationCounter& operator=(const AllocationCounter&) = delete;
+
+    size_t count() const { return allocations; }
+};
+
+void* operator new(size_t size) {
+    if (allocation_counter) ++*allocation_counter;
+    if (void* p = std::malloc(size ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+// not inlined, or GCC pairs the inlined free() with a call to operator new
+[[gnu::noinline]] void operator delete(void* p) noexcept { std::free(p); }
+[[gnu::noinline]] void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+TEST(PersonBuilderTest, SettersAllocateOncePerLongField) {
+    const std::string company = "Company Number 7 Holdings Ltd";
+    AllocationCounter allocations;
+    PersonBuilder builder;
+    builder.lives()
+               .at("221B Long Residential Street Name") // literal: copied once
+               .in(std::string_view("London"))          // fits the small-string buffer
+           .works()
+               .at(std::string(company))                // temporary: moved in
+               .as_a(company);                          // lvalue: copied once
+    Person p = std::move(builder).build();
+    // street and position copied, the temporary moved into company_name
+    EXPECT_EQ(allocations.count(), size_t(3));
+    EXPECT_EQ(p.get_street_address(), "221B Long Residential Street Name");
+    EXPECT_EQ(p.get_company_name(), company);
+    EXPECT_EQ(p.get_position(), company);
+}
+
+TEST(PersonBuilderTest, ConvertingLeavesSharedBuilderEmpty) {
+    PersonBuilder builder;
+    Person first = builder.works().at("Acme").earning(100);
+    Person second = builder.lives().in("Paris");
+
+    EXPECT_EQ(first.get_company_name(), "Acme");
+    EXPECT_EQ(second.get_city(), "Paris");
+    EXPECT_EQ(second.get_company_name(), "");
+    EXPECT_EQ(second.get_annual_income(), 0);
+}
+
+TEST(PersonBuilderTest, ReusableBuilderKeepsBuffers) {
+    ReusablePersonBuilder builder;
+    Person out = builder.build();
+    builder.lives().at("221B Long Residential Street Name").in("London")
+           .works().at("Company Number 7 Holdings Ltd").earning(100);
+    builder.build_into(out);
+    EXPECT_EQ(out.get_city(), "London");
+
+    {
+        AllocationCounter allocations;
+        builder.lives().at("4 Privet Drive, Little Whinging").in("Surrey")
+               .works().at("Grunnings Drill Manufacturers").earning(200);
+        builder.build_into(out);
+        EXPECT_EQ(allocations.count(), size_t(0));
+    }
+    EXPECT_EQ(out.get_street_address(), "4 Privet Drive, Little Whinging");
+    EXPECT_EQ(out.get_annual_income(), 200);
+
+    // validation is opt-in: a freelancer builds as given
+    builder.works().as_a("Freelancer").earning(50'000);
+    builder.build_into(out);
+    EXPECT_EQ(out.get_company_name(), "");
+    EXPECT_EQ(out.get_position(), "Freelancer");
+}
+
+TEST(PersonBuilderTest, ReusableBuilderKeepsBuffersThroughFacetConversion) {
+    static_assert(!std::is_convertible_v<ReusablePersonBuilder&, Person>);
+    ReusablePersonBuilder builder;
+    Person first = builder.lives().at("221B Long Residential Street Name").in("London")
+                          .works().at("Company Number 7 Holdings Ltd").earning(100);
+    EXPECT_EQ(first.get_street_address(), "221B Long Residential Street Name");
+    EXPECT_EQ(first.get_company_name(), "Company Number 7 Holdings Ltd");
+
+    Person out = builder.build(); // the conversion cleared the stage
+    EXPECT_EQ(out.get_city(), "");
+    EXPECT_EQ(out.get_annual_income(), 0);
+
+    AllocationCounter allocations;
+    builder.lives().at("4 Privet Drive, Little Whinging").in("Surrey")
+           .works().at("Grunnings Drill Manufacturers").earning(200);
+    EXPECT_EQ(allocations.count(), size_t(0));
+    builder.clear();
+}
+
+TEST(PersonBuilderTest, ValidateChecksTheStagedRecord) {
+    ReusablePersonBuilder builder;
+    builder.works().at("Acme").earning(100);
+    EXPECT_NO_THROW(builder.validate());
+    builder.clear();
+
+    builder.works().as_a("Manager");
+    EXPECT_THROW(builder.validate(), std::invalid_argument);
+    builder.works().at("Acme");
+    EXPECT_NO_THROW(builder.validate());
+    builder.clear();
+
+    builder.works().at("Acme").earning(-1);
+    EXPECT_THROW(builder.validate(), std::invalid_argument);
+    builder.clear();
+
+    builder.lives().with_postcode("NW1 6XE");
+    EXPECT_THROW(builder.validate(), std::invalid_argument);
+    EXPECT_EQ(builder.build().get_post_code(), "NW1 6XE");
+}
+
+TEST(PersonBuilderTest, BuildViewIntoArena) {
+    PersonArena arena;
+    std::string street = "123 Test St";
+    PersonView p = Person::create(arena)
+                .lives()
+                    .at(street)
+                    .with_postcode("12345")
+                    .in("Test City")
+                .works()
+                    .at("Test Company")
+                    .earning(100000);
+    street.assign("overwritten");
+
+    EXPECT_EQ(p.get_street_address(), "123 Test St");
+    EXPECT_EQ(p.get_post_code(), "12345");
+    EXPECT_EQ(p.get_city(), "Test City");
+    EXPECT_EQ(p.get_company_name(), "Test Company");
+    EXPECT_EQ(p.get_position(), "");
+    EXPECT_EQ(p.get_annual_income(), 100000);
+    EXPECT_EQ(arena.bytes_used(), std::string_view("123 Test St12345Test CityTest Company").size());
+}
+
+TEST(PersonBuilderTest, ArenaViewsSurviveGrowth) {
+    PersonArena arena(64);
+    std::vector<PersonView> people;
+    const std::string long_street(1000, 'x');
+    for (int i = 0; i < 100; ++i) {
+        people.push_back(Person::create(arena).lives().at(long_street).in(std::to_string(i)));
+    }
+    for (int i = 0; i < 100; ++i) {
+        EXPECT_EQ(people[i].get_street_address(), long_street);
+        EXPECT_EQ(people[i].get_city(), std::to_string(i));
+    }
+}
+
+TEST(PersonTableTest, FacetsAppendIntoColumns) {
+    PersonTable table;
+    table.append().lives().at("1 High St").in("London").works().at("Acme").as_a("Developer").earning(100);
+    table.append().lives().in("Paris").works().at("Acme").earning(200);
+    table.append().lives().in("London").works().at("Initech").as_a("Manager").earning(400);
+
+    ASSERT_EQ(table.size(), size_t(3));
+    PersonView first = table[0];
+    EXPECT_EQ(first.get_street_address(), "1 High St");
+    EXPECT_EQ(first.get_city(), "London");
+    EXPECT_EQ(first.get_position(), "Developer");
+    EXPECT_EQ(table[1].get_position(), "");
+    EXPECT_EQ(table.dictionary(PersonField::city).size(), size_t(3)); // "", London, Paris
+
+    auto london = *table.dictionary(PersonField::city).find("London");
+    EXPECT_EQ(table.count_by(PersonField::city)[london], uint64_t(2));
+    auto acme = *table.dictionary(PersonField::company_name).find("Acme");
+    EXPECT_EQ(table.sum_income_by(PersonField::company_name)[acme], 300);
+
+    EXPECT_EQ(table.rows_where(PersonField::city, "London"), (std::vector<uint32_t>{0, 2}));
+    EXPECT_TRUE(table.rows_where(PersonField::city, "Berlin").empty());
+    EXPECT_EQ(table.sum_income(table.rows_earning_at_least(200)), 600);
+    EXPECT_EQ(table.sum_income(), 700);
+}
+
+TEST(PersonTableTest, FieldsThatAreNotColumnsAreRejected) {
+    PersonTable table;
+    table.append().lives().at("1 High St").in("London").works().earning(100);
+    for (auto field : {PersonField::street_address, PersonField::post_code, PersonField::annual_income}) {
+        EXPECT_THROW(table.count_by(field), std::invalid_argument);
+        EXPECT_THROW(table.sum_income_by(field), std::invalid_argument);
+        EXPECT_THROW(table.rows_where(field, "London"), std::invalid_argument);
+    }
+    EXPECT_THROW(table.set(0, PersonField::city, 5), std::invalid_argument);
+    EXPECT_THROW(table.set(0, PersonField::annual_income, "5"), std::invalid_argument);
+    EXPECT_EQ(table[0].get_city(), "London");
+    EXPECT_EQ(table[0].get_annual_income(), 100);
+}
+
+static std::vector<Person> awkward_persons() {
+    std::vector<Person> people;
+    people.push_back(Person::create()
+        .lives().at("221B Baker Street, Marylebone").with_postcode("NW1 6XE").in("London")
+        .works().at("Holmes \"Consulting\" Detectives").as_a("Detective").earning(250'000));
+    people.push_back(Person::create());
+    people.push_back(Person::create().lives().at(std::string(300, 'x') + "\nsecond line\r\n").in("Paris"));
+    people.push_back(Person::create().works().at("Acme").earning(std::numeric_limits<int>::max()));
+    // records ReusablePersonBuilder::validate() would refuse still round-trip
+    people.push_back(Person::create().works().as_a("Freelancer").earning(50'000));
+    people.push_back(Person::create().lives().with_postcode("NW1 6XE").works().at("Acme").earning(-1));
+    return people;
+}
+
+static void expect_same(const Person& a, const Person& b) {
+    EXPECT_EQ(a.get_street_address(), b.get_street_address());
+    EXPECT_EQ(a.get_post_code(), b.get_post_code());
+    EXPECT_EQ(a.get_city(), b.get_city());
+    EXPECT_EQ(a.get_company_name(), b.get_company_name());
+    EXPECT_EQ(a.get_position(), b.get_position());
+    EXPECT_EQ(a.get_annual_income(), b.get_annual_income());
+}
+
+template <typename Writer, typename Reader>
+static void expect_round_trip(const std::string& path) {
+    const auto people = awkward_persons();
+    {
+        Writer writer(path);
+        for (const auto& p : people) writer.write(p);
+    }
+    Reader reader(path);
+    Person p = Person::create();
+    for (const auto& expected : people) {
+        ASSERT_TRUE(reader.read(p));
+        expect_same(p, expected);
+    }
+    EXPECT_FALSE(reader.read(p));
+    std::remove(path.c_str());
+}
+
+TEST(PersonSerializerTest, BinaryRoundTrip) {
+    expect_round_trip<PersonBinaryWriter, PersonBinaryReader>(
+        testing::TempDir() + "persons_" + std::to_string(::getpid()) + ".bin");
+}
+
+TEST(PersonSerializerTest, CsvRoundTrip) {
+    expect_round_trip<PersonCsvWriter, PersonCsvReader>(
+        testing::TempDir() + "persons_" + std::to_string(::getpid()) + ".csv");
+}
+
+TEST(PersonSerializerTest, FailedWritesAreReported) {
+    // /dev/full accepts the open and fails every write with ENOSPC
+    if (!std::filesystem::exists("/dev/full")) GTEST_SKIP() << "no /dev/full";
+    {
+        PersonBinaryWriter binary("/dev/full");
+        binary.write(awkward_persons()[0]);
+        EXPECT_THROW(binary.flush(), std::runtime_error);
+    } // the destructor's failed flush must not throw
+    {
+        PersonCsvWriter csv("/dev/full");
+        csv.write(awkward_persons()[0]);
+        EXPECT_THROW(csv.flush(), std::runtime_error);
+    }
+}
+
+TEST(PersonSerializerTest, RejectsBadInput) {
+    const std::string path = testing::TempDir() + "persons_bad_" + std::to_string(::getpid());
+    Person p = Person::create();
+    {
+        std::ofstream(path, std::ios::binary) << person_csv_header << "1 Main St,,Springfield,Acme,,12\r\n"
+                                              << "2 Main St,,Springfield,Acme,,not a number\n";
+    }
+    PersonCsvReader csv(path);
+    ASSERT_TRUE(csv.read(p));
+    EXPECT_EQ(p.get_annual_income(), 12);
+    EXPECT_THROW(csv.read(p), std::runtime_error);
+
+    {
+        PersonBinaryWriter writer(path);
+        writer.write(awkward_persons()[0]);
+    }
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+    PersonBinaryReader binary(path);
+    EXPECT_THROW(binary.read(p), std::runtime_error);
+    EXPECT_THROW(PersonCsvReader{path}, std::runtime_error);
+    std::remove(path.c_str());
+}
+
+// Benchmarks are disabled by default, run them with:
+//   ./person --gtest_also_run_disabled_tests --gtest_filter='PersonBenchmark.*'
+// PERSON_BENCH_N overrides the number of persons (default 10M).
+// Import records with field lengths typical of the feed: streets and
+// companies past the small-string buffer, post codes and cities inside it.
+struct ImportRecord {
+    std::string street_address, post_code, city, company_name, position;
+    int annual_income;
+};
+
+static std::vector<ImportRecord> import_records() {
+    static const char* cities[] = {"London", "Paris", "Berlin", "Madrid", "Rome", "Vienna", "Oslo", "Lisbon"};
+    static const char* positions[] = {"Developer", "Manager", "Analyst", "Designer", "Director"};
+    std::vector<ImportRecord> records;
+    for (int i = 0; i < 4096; ++i) {
+        std::string n = std::to_string(i);
+        records.push_back({n + " Long Residential Street Name", "PC" + n, cities[i % 8],
+                           "Company Number " + n + " Holdings Ltd", positions[i % 5], 30000 + i});
+    }
+    return records;
+}
+
+template <typename Build>
+static void bench_build(const char* label, Build&& build) {
+    const size_t n = bench_size("PERSON_BENCH_N", 10'000'000);
+    const auto records = import_records();
+    long rss0 = current_rss_kb();
+    auto t0 = bench_clock::now();
+    auto people = build(n, records); // kept alive for the RSS reading
+    double ms = elapsed_ms(t0);
+    std::cout << n << " persons, " << label << ": " << static_cast<long>(n / ms * 1000) << " persons/sec, "
+              << (current_rss_kb() - rss0) / 1024 << " MB RSS\n";
+}
+
+TEST(PersonBenchmark, DISABLED_BuildPersons) {
+    bench_build("std::string fields", [](size_t n, const std::vector<ImportRecord>& records) {
+        std::vector<Person> people;
+        people.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            const auto& r = records[i % records.size()];
+            people.push_back(Person::create()
+                .lives().at(r.street_address).with_postcode(r.post_code).in(r.city)
+                .works().at(r.company_name).as_a(r.position).earning(r.annual_income));
+        }
+        return people;
+    });
+}
+
+TEST(PersonBenchmark, DISABLED_BuildPersonViewsInArena) {
+    PersonArena arena(64 << 20);
+    bench_build("arena views", [&](size_t n, const std::vector<ImportRecord>& records) {
+        std::vector<PersonView> people;
+        people.reserve(n);
+        for (size_t i = 0; i < n; ++i) {
+            const auto& r = records[i % records.size()];
+            people.push_back(Person::create(arena)
+                .lives().at(r.street_address).with_postcode(r.post_code).in(r.city)
+                .works().at(r.company_name).as_a(r.position).earning(r.annual_income));
+        }
+        return people;
+    });
+}
+
+// Group by city, sum income by company, and filter-then-sum over the same
+// persons held as std::vector<Person> and as a PersonTable.
+// PERSON_BENCH_ROWS overrides the number of persons (default 2M).
+TEST(PersonBenchmark, DISABLED_TableQueriesVsVector) {
+    const size_t n = bench_size("PERSON_BENCH_ROWS", 2'000'000);
+    const auto records = import_records();
+    std::vector<Person> people;
+    PersonTable table;
+    people.reserve(n);
+    for (size_t i = 0; i < n; ++i) {
+        const auto& r = records[i % records.size()];
+        people.push_back(Person::create()
+            .lives().at(r.street_address).with_postcode(r.post_code).in(r.city)
+            .works().at(r.company_name).as_a(r.position).earning(r.annual_income));
+        table.append()
+            .lives().at(r.street_address).with_postcode(r.post_code).in(r.city)
+            .works().at(r.company_name).as_a(r.position).earning(r.annual_income);
+    }
+
+    auto report = [](const char* query, double vector_ms, double table_ms) {
+        std::cout << query << ": vector<Person> " << vector_ms << " ms, PersonTable " << table_ms
+                  << " ms (" << vector_ms / table_ms << "x)\n";
+    };
+
+    auto t0 = bench_clock::now();
+    std::unordered_map<std::string_view, uint64_t> per_city;
+    for (const auto& p : people) ++per_city[p.get_city()];
+    double vector_ms = elapsed_ms(t0);
+    t0 = bench_clock::now();
+    auto counts = table.count_by(PersonField::city);
+    report("count by city", vector_ms, elapsed_ms(t0));
+    EXPECT_EQ(counts[*table.dictionary(PersonField::city).find("Paris")], per_city["Paris"]);
+
+    t0 = bench_clock::now();
+    std::unordered_map<std::string_view, int64_t> per_company;
+    for (const auto& p : people) per_company[p.get_company_name()] += p.get_annual_income();
+    vector_ms = elapsed_ms(t0);
+    t0 = bench_clock::now();
+    auto sums = table.sum_income_by(PersonField::company_name);
+    report("sum income by company", vector_ms, elapsed_ms(t0));
+    EXPECT_EQ(sums[*table.dictionary(PersonField::company_name).find("Company Number 7 Holdings Ltd")],
+              per_company["Company Number 7 Holdings Ltd"]);
+
+    t0 = bench_clock::now();
+    int64_t vector_sum = 0;
+    for (const auto& p : people) {
+        if (p.get_city() == "Berlin") vector_sum += p.get_annual_income();
+    }
+    vector_ms = elapsed_ms(t0);
+    t0 = bench_clock::now();
+    int64_t table_sum = table.sum_income(table.rows_where(PersonField::city, "Berlin"));
+    report("sum income where city = Berlin", vector_ms, elapsed_ms(t0));
+    EXPECT_EQ(table_sum, vector_sum);
+
+    t0 = bench_clock::now();
+    vector_sum = 0;
+    for (const auto& p : people) vector_sum += p.get_annual_income();
+    vector_ms = elapsed_ms(t0);
+    t0 = bench_clock::now();
+    table_sum = table.sum_income();
+    report("sum income", vector_ms, elapsed_ms(t0));
+    EXPECT_EQ(table_sum, vector_sum);
+}
+
+// Heap allocations per person built, streets and companies being longer
+// than the small-string buffer.
+TEST(PersonBenchmark, DISABLED_AllocationsPerPerson) {
+    const size_t n = bench_size("PERSON_BENCH_N", 10'000'000);
+    const auto records = import_records();
+    int64_t checksum = 0;
+    auto run = [&](const char* label, auto&& build) {
+        AllocationCounter allocations;
+        auto t0 = bench_clock::now();
+        for (size_t i = 0; i < n; ++i) checksum += build(records[i % records.size()]);
+        double ms = elapsed_ms(t0);
+        std::cout << label << ": " << double(allocations.count()) / n << " allocations/person, "
+                  << static_cast<long>(n / ms * 1000) << " persons/sec\n";
+    };
+
+    run("from std::string lvalues", [](const ImportRecord& r) {
+        Person p = Person::create()
+            .lives().at(r.street_address).with_postcode(r.post_code).in(r.city)
+            .works().at(r.company_name).as_a(r.position).earning(r.annual_income);
+        return p.get_annual_income();
+    });
+    run("from std::string temporaries", [](const ImportRecord& r) {
+        Person p = Person::create()
+            .lives().at(std::string(r.street_address)).with_postcode(std::string(r.post_code))
+                .in(std::string(r.city))
+            .works().at(std::string(r.company_name)).as_a(std::string(r.position)).earning(r.annual_income);
+        return p.get_annual_income();
+    });
+    run("from literals", [](const ImportRecord& r) {
+        Person p = Person::create()
+            .lives().at("221B Long Residential Street Name").with_postcode("NW1 6XE").in("London")
+            .works().at("Company Number 7 Holdings Ltd").as_a("Developer").earning(r.annual_income);
+        return p.get_annual_income();
+    });
+    ReusablePersonBuilder reusable;
+    Person out = reusable.build();
+    run("reusable builder, build_into", [&](const ImportRecord& r) {
+        reusable.lives().at(r.street_address).with_postcode(r.post_code).in(r.city)
+                .works().at(r.company_name).as_a(r.position).earning(r.annual_income);
+        reusable.build_into(out);
+        return out.get_annual_income();
+    });
+    EXPECT_NE(checksum, 0);
+}
+
+// Writes and reads back PERSON_BENCH_N persons (default 10M) in each
+// format; operator<< can only be written.
+TEST(PersonBenchmark, DISABLED_SerializeRecords) {
+    const size_t n = bench_size("PERSON_BENCH_N", 10'000'000);
+    std::vector<Person> people;
+    for (const auto& r : import_records()) {
+        people.push_back(Person::create()
+            .lives().at(r.street_address).with_postcode(r.post_code).in(r.city)
+            .works().at(r.company_name).as_a(r.position).earning(r.annual_income));
+    }
+    const std::string path = testing::TempDir() + "persons_bench";
+    auto report = [&](const char* label, bench_clock::time_point t0) {
+        double ms = elapsed_ms(t0);
+        std::cout << label << ": " << static_cast<long>(n / ms * 1000) << " records/sec, "
+                  << std::filesystem::file_size(path) / (1 << 20) << " MB\n";
+    };
+
+    auto t0 = bench_clock::now();
+    {
+        std::ofstream os(path);
+        for (size_t i = 0; i < n; ++i) os << people[i % people.size()];
+    }
+    report("operator<< write", t0);
+
+    auto round_trip = [&]<typename Writer, typename Reader>(const char* format) {
+        auto t0 = bench_clock::now();
+        {
+            Writer writer(path);
+            for (size_t i = 0; i < n; ++i) writer.write(people[i % people.size()]);
+        }
+        report((std::string(format) + " write").c_str(), t0);
+
+        t0 = bench_clock::now();
+        Reader reader(path);
+        Person p = Person::create();
+        size_t read = 0;
+        int64_t income = 0;
+        while (reader.read(p)) {
+            ++read;
+            income += p.get_annual_income();
+        }
+        report((std::string(format) + " read").c_str(), t0);
+        EXPECT_EQ(read, n);
+        EXPECT_NE(income, 0);
+    };
+    round_trip.operator()<PersonBinaryWriter, PersonBinaryReader>("binary");
+    round_trip.operator()<PersonCsvWriter, PersonCsvReader>("CSV");
+    std::remove(path.c_str());
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
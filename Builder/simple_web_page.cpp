@@ -2,8 +2,32 @@
 #include <string>
 #include <sstream>
 #include <iostream>
+#include <fstream>
 #include <memory>
+#include <string_view>
+#include <chrono>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+#include <bit>
+#include <limits>
+#include <stdexcept>
+#include <memory_resource>
+#include <optional>
+#include <unordered_map>
+#include <new>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <exception>
+#include <atomic>
+#include <cstdio>
+#include <unistd.h>
 #include <gtest/gtest.h>
+#include "bench.h"
 
 
 struct Tag;
@@ -52,6 +76,199 @@ struct IMG : Tag {
     }
 };
 
+// Output kept in fixed-size chunks, so appending never moves what has been
+// written. With a sink, each full chunk is written to it and reused, and
+// only one chunk is ever held.
+class ChunkedOutput {
+    std::vector<std::unique_ptr<char[]>> chunks;
+    size_t chunk_size;
+    size_t used = 0; // in chunks.back()
+    size_t total = 0;
+    std::ostream* sink;
+
+public:
+    explicit ChunkedOutput(size_t chunk_size = 64 * 1024, std::ostream* sink = nullptr)
+        : chunk_size(chunk_size), sink(sink) {
+        chunks.push_back(std::make_unique<char[]>(chunk_size));
+    }
+    ChunkedOutput(const ChunkedOutput&) = delete;
+    ChunkedOutput& operator=(const ChunkedOutput&) = delete;
+    ~ChunkedOutput() { flush(); }
+
+    void append(const char* data, size_t n) {
+        total += n;
+        if (n <= chunk_size - used) { // the common case: fits in this chunk
+            std::memcpy(chunks.back().get() + used, data, n);
+            used += n;
+            return;
+        }
+        while (n > 0) {
+            if (used == chunk_size) next_chunk();
+            size_t take = std::min(n, chunk_size - used);
+            std::memcpy(chunks.back().get() + used, data, take);
+            used += take;
+            data += take;
+            n -= take;
+        }
+    }
+    void append(std::string_view s) { append(s.data(), s.size()); }
+
+    // Bytes appended so far, including any already written to the sink.
+    size_t size() const { return total; }
+
+    // What hasn't gone to the sink yet.
+    std::string str() const {
+        std::string out;
+        out.reserve((chunks.size() - 1) * chunk_size + used);
+        for (size_t i = 0; i + 1 < chunks.size(); ++i) out.append(chunks[i].get(), chunk_size);
+        out.append(chunks.back().get(), used);
+        return out;
+    }
+
+    // Writes the partly filled chunk to the sink, if there is one.
+    void flush() {
+        if (!sink || used == 0) return;
+        sink->write(chunks.back().get(), static_cast<std::streamsize>(used));
+        used = 0;
+    }
+
+private:
+    void next_chunk() {
+        if (sink) {
+            flush();
+        } else {
+            chunks.push_back(std::make_unique<char[]>(chunk_size));
+            used = 0;
+        }
+    }
+};
+
+// HTML escaping. Clean runs are found eight bytes at a time (SWAR: a
+// 64-bit word compared against each special byte at once) and copied with
+// one append.
+namespace html_escape {
+
+// High bit set in each byte of `word` equal to `c`. Bytes above the first
+// match may be false positives; the lowest set bit is exact.
+inline uint64_t match(uint64_t word, char c) {
+    uint64_t x = word ^ (0x0101010101010101ull * static_cast<uint8_t>(c));
+    return (x - 0x0101010101010101ull) & ~x & 0x8080808080808080ull;
+}
+
+inline bool special(char c, bool attribute) {
+    return c == '&' || c == '<' || c == '>' || (attribute && c == '"');
+}
+
+// Position of the first byte to escape at or after `from`, or s.size().
+inline size_t find_special(std::string_view s, size_t from, bool attribute) {
+    size_t i = from;
+    if constexpr (std::endian::native == std::endian::little) {
+        for (; i + 8 <= s.size(); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, s.data() + i, 8);
+            uint64_t hits = match(word, '&') | match(word, '<') | match(word, '>');
+            if (attribute) hits |= match(word, '"');
+            if (hits) return i + static_cast<size_t>(std::countr_zero(hits)) / 8;
+        }
+    }
+    for (; i < s.size(); ++i) {
+        if (special(s[i], attribute)) return i;
+    }
+    return s.size();
+}
+
+// Appends s with &, <, > (and " in attribute values) as entities.
+template <typename Out>
+void append(Out& out, std::string_view s, bool attribute) {
+    for (size_t i = 0; i < s.size(); ) {
+        size_t j = find_special(s, i, attribute);
+        out.append(s.data() + i, j - i);
+        if (j == s.size()) break;
+        std::string_view entity = s[j] == '&' ? "&amp;" : s[j] == '<' ? "&lt;" : s[j] == '>' ? "&gt;" : "&quot;";
+        out.append(entity.data(), entity.size());
+        i = j + 1;
+    }
+}
+
+} // namespace html_escape
+
+// Elements that have no content and no end tag.
+inline bool is_void_element(std::string_view name) {
+    static constexpr std::string_view void_elements[] = {
+        "area", "base", "br", "col", "embed", "hr", "img", "input", "link", "meta", "source", "track", "wbr"};
+    return std::find(std::begin(void_elements), std::end(void_elements), name) != std::end(void_elements);
+}
+
+// Writes the start tag with escaped attribute values (a range of
+// name/value pairs), then the escaped text. False if this is a void
+// element with nothing inside, which gets no end tag.
+template <typename Out, typename Attributes>
+bool write_start_tag(Out& out, std::string_view name, const Attributes& attributes,
+                     std::string_view text, bool has_children) {
+    auto put = [&out](std::string_view s) { out.append(s.data(), s.size()); };
+    put("<");
+    put(name);
+    for (const auto& [attribute, value] : attributes) {
+        put(" ");
+        put(attribute);
+        put("=\"");
+        html_escape::append(out, value, true);
+        put("\"");
+    }
+    put(">");
+    if (text.empty() && !has_children && is_void_element(name)) return false;
+    html_escape::append(out, text, false);
+    return true;
+}
+
+template <typename Out>
+void write_end_tag(Out& out, std::string_view name) {
+    out.append("</", 2);
+    out.append(name.data(), name.size());
+    out.append(">", 1);
+}
+
+// Serializes `root` to `out` (anything with append(const char*, size_t),
+// e.g. a ChunkedOutput). Unlike operator<<, escapes text and attribute
+// values, writes a void element without content as just its start tag, and
+// walks the tree with an explicit stack so depth is unbounded.
+template <typename Out>
+void write_html(Out& out, const Tag& root) {
+    auto open = [&out](const Tag& tag) {
+        return write_start_tag(out, tag.name, tag.attributes, tag.text, !tag.children.empty());
+    };
+    auto close = [&out](const Tag& tag) { write_end_tag(out, tag.name); };
+
+    struct Frame {
+        const Tag* tag;
+        size_t next_child;
+    };
+    std::vector<Frame> stack;
+    if (open(root)) stack.push_back({&root, 0});
+    while (!stack.empty()) {
+        Frame& top = stack.back();
+        if (top.next_child < top.tag->children.size()) {
+            const Tag& child = top.tag->children[top.next_child++];
+            if (open(child)) stack.push_back({&child, 0}); // invalidates top
+        } else {
+            close(*top.tag);
+            stack.pop_back();
+        }
+    }
+}
+
+// Indentation for the pretty printers, copied from a static table of spaces.
+template <typename Out>
+void append_spaces(Out& out, size_t n) {
+    static constexpr std::string_view spaces =
+        "                                                                "
+        "                                                                "
+        "                                                                "
+        "                                                                ";
+    for (; n > spaces.size(); n -= spaces.size()) out.append(spaces.data(), spaces.size());
+    out.append(spaces.data(), n);
+}
+
 struct HtmlElement {
     std::string name;
     std::string text;
@@ -63,6 +280,8 @@ struct HtmlElement {
     }
 
     friend struct HtmlBuilder;
+    friend class HtmlFragmentCache;
+    friend class ParallelHtmlRenderer;
 
     std::string str(int indent = 0) const {
         // pretty-print the contents
@@ -78,26 +297,848 @@ struct HtmlElement {
         return oss.str();
     }
 
+    // Same bytes as str(indent), rendered without recursion into one buffer
+    // sized up front.
+    std::string render(int indent = 0) const {
+        std::string out;
+        out.reserve(rendered_size(indent));
+        render_to(out, indent);
+        return out;
+    }
+
+    // Appends what str(indent) returns to `out`, which needs
+    // append(const char*, size_t). Walks the tree with an explicit stack,
+    // so depth is bounded by memory rather than by the call stack.
+    template <typename Out>
+    void render_to(Out& out, int indent = 0) const {
+        auto line = [&out](size_t spaces, std::string_view a, std::string_view b, std::string_view c) {
+            append_spaces(out, spaces);
+            out.append(a.data(), a.size());
+            out.append(b.data(), b.size());
+            out.append(c.data(), c.size());
+        };
+        auto open = [&](const HtmlElement& e, size_t at) {
+            line(at, "<", e.name, ">\n");
+            if (!e.text.empty()) line(at + e.indent_spaces, "", e.text, "\n");
+        };
+        walk(static_cast<size_t>(indent), open,
+             [&](const HtmlElement& e, size_t at) { line(at, "</", e.name, ">\n"); });
+    }
+
+    // Length of str(indent), without rendering it.
+    size_t rendered_size(int indent = 0) const {
+        size_t size = 0;
+        auto open = [&size](const HtmlElement& e, size_t at) {
+            size += at + e.name.size() + 3;
+            if (!e.text.empty()) size += at + e.indent_spaces + e.text.size() + 1;
+        };
+        walk(static_cast<size_t>(indent), open,
+             [&size](const HtmlElement& e, size_t at) { size += at + e.name.size() + 4; });
+        return size;
+    }
+
 protected:  // hide the constructor
     HtmlElement() { }
+
+    // Calls open(element, indent) in document order and close(element,
+    // indent) once its children are done, using a heap-allocated stack.
+    template <typename Open, typename Close>
+    void walk(size_t indent, Open&& open, Close&& close) const {
+        struct Frame {
+            const HtmlElement* element;
+            size_t next_child;
+            size_t indent;
+        };
+        std::vector<Frame> stack{{this, 0, indent}};
+        open(*this, indent);
+        while (!stack.empty()) {
+            Frame& top = stack.back();
+            if (top.next_child < top.element->elements.size()) {
+                const HtmlElement& child = top.element->elements[top.next_child++];
+                size_t child_indent = top.indent + top.element->indent_spaces;
+                open(child, child_indent);
+                stack.push_back({&child, 0, child_indent}); // invalidates top
+            } else {
+                close(*top.element, top.indent);
+                stack.pop_back();
+            }
+        }
+    }
+
     HtmlElement(const std::string& name, const std::string& text)
         : name(name), text(text) { }
 };
 
+// Renders like HtmlElement::render(), reusing the bytes of repeated
+// subtrees. A subtree is identified by a 64-bit hash of its structure
+// (names, text, indent_spaces and its children's hashes, in order); one
+// of two or more elements that occurs more than once in the tree is
+// rendered the first time, stored keyed by its hash and indent together
+// with a copy of the subtree, and appended from the store every time after
+// that, this render or later ones, once the subtree compares equal to the
+// copy. A hash collision therefore only costs a normal render.
+//
+// The per-node hashes are computed in one pass over the tree and kept
+// until invalidate(); the tree must not change in between, which is why
+// HtmlBuilder keeps its tree private and invalidates on every mutation.
+// Rehashing drops stored fragments the tree no longer repeats; clear()
+// drops them all. Not thread-safe: render() updates the store.
+class HtmlFragmentCache {
+    // per node in pre-order (the order render() visits them)
+    std::vector<uint64_t> hashes;
+    std::vector<uint32_t> subtree_sizes;
+    std::unordered_map<uint64_t, uint32_t> occurrences;
+    bool hashed = false;
+    size_t last_size = 0;
+
+    struct Fragment {
+        uint64_t hash;
+        HtmlElement source; // what `bytes` were rendered from
+        std::string bytes;
+    };
+    std::unordered_map<uint64_t, Fragment> fragments; // by fragment_key()
+    std::vector<std::pair<const HtmlElement*, const HtmlElement*>> compare_stack;
+
+public:
+    void invalidate() { hashed = false; }
+    void clear() {
+        invalidate();
+        fragments.clear();
+    }
+    size_t fragment_count() const { return fragments.size(); }
+
+    std::string render(const HtmlElement& root) {
+        if (!hashed) hash_tree(root);
+        std::string out;
+        out.reserve(last_size);
+        render_to(root, out);
+        last_size = out.size();
+        return out;
+    }
+
+private:
+    static uint64_t mix(uint64_t h) { // splitmix64 finalizer
+        h ^= h >> 30;
+        h *= 0xbf58476d1ce4e5b9ull;
+        h ^= h >> 27;
+        h *= 0x94d049bb133111ebull;
+        return h ^ (h >> 31);
+    }
+    static uint64_t add(uint64_t h, std::string_view s) { // FNV-1a, length first
+        h = (h ^ s.size()) * 0x100000001b3ull;
+        for (char c : s) h = (h ^ static_cast<uint8_t>(c)) * 0x100000001b3ull;
+        return h;
+    }
+    static uint64_t fragment_key(uint64_t hash, size_t indent) { return mix(hash + indent * 0x9e3779b97f4a7c15ull); }
+
+    bool repeated(uint64_t hash) const {
+        auto it = occurrences.find(hash);
+        return it != occurrences.end() && it->second > 1;
+    }
+
+    bool same_tree(const HtmlElement& a, const HtmlElement& b) {
+        compare_stack.assign(1, {&a, &b});
+        while (!compare_stack.empty()) {
+            auto [x, y] = compare_stack.back();
+            compare_stack.pop_back();
+            if (x->name != y->name || x->text != y->text || x->indent_spaces != y->indent_spaces
+                || x->elements.size() != y->elements.size())
+                return false;
+            for (size_t i = 0; i < x->elements.size(); ++i) compare_stack.emplace_back(&x->elements[i], &y->elements[i]);
+        }
+        return true;
+    }
+
+    void hash_tree(const HtmlElement& root) {
+        hashes.clear();
+        subtree_sizes.clear();
+        occurrences.clear();
+        struct Pending {
+            uint32_t index;
+            uint64_t running;
+        };
+        std::vector<Pending> pending;
+        root.walk(0,
+            [&](const HtmlElement& e, size_t) {
+                auto index = static_cast<uint32_t>(hashes.size());
+                hashes.push_back(0);
+                subtree_sizes.push_back(0);
+                pending.push_back({index, add(add(0xcbf29ce484222325ull ^ e.indent_spaces, e.name), e.text)});
+            },
+            [&](const HtmlElement&, size_t) {
+                Pending done = pending.back();
+                pending.pop_back();
+                subtree_sizes[done.index] = static_cast<uint32_t>(hashes.size() - done.index);
+                uint64_t hash = mix(done.running ^ subtree_sizes[done.index]);
+                hashes[done.index] = hash;
+                ++occurrences[hash];
+                if (!pending.empty()) pending.back().running = (pending.back().running ^ hash) * 0x100000001b3ull;
+            });
+        std::erase_if(fragments, [this](const auto& entry) { return !repeated(entry.second.hash); });
+        hashed = true;
+    }
+
+    void render_to(const HtmlElement& root, std::string& out) {
+        auto line = [&out](size_t spaces, std::string_view a, std::string_view b, std::string_view c) {
+            append_spaces(out, spaces);
+            out.append(a).append(b).append(c);
+        };
+        struct Frame {
+            const HtmlElement* element;
+            size_t next_child;
+            uint32_t next_index; // pre-order index of next_child
+            size_t indent;
+            size_t capture_from; // where this subtree's bytes start, if it is to be stored
+            uint64_t hash;
+        };
+        static constexpr size_t not_captured = std::numeric_limits<size_t>::max();
+        std::vector<Frame> stack;
+
+        // Appends e's rendering from the store or opens it; false if done.
+        auto visit = [&](const HtmlElement& e, uint32_t index, size_t indent) {
+            size_t capture_from = not_captured;
+            // a single element renders faster than it is looked up
+            if (index != 0 && subtree_sizes[index] > 1 && repeated(hashes[index])) {
+                auto it = fragments.find(fragment_key(hashes[index], indent));
+                if (it == fragments.end()) {
+                    capture_from = out.size();
+                } else if (same_tree(it->second.source, e)) {
+                    out.append(it->second.bytes);
+                    return;
+                } // else a collision: render it, keeping what is stored
+            }
+            line(indent, "<", e.name, ">\n");
+            if (!e.text.empty()) line(indent + e.indent_spaces, "", e.text, "\n");
+            stack.push_back({&e, 0, index + 1, indent, capture_from, hashes[index]});
+        };
+
+        visit(root, 0, 0);
+        while (!stack.empty()) {
+            Frame& top = stack.back();
+            if (top.next_child < top.element->elements.size()) {
+                const HtmlElement& child = top.element->elements[top.next_child++];
+                uint32_t index = top.next_index;
+                top.next_index += subtree_sizes[index];
+                visit(child, index, top.indent + top.element->indent_spaces); // may invalidate top
+            } else {
+                line(top.indent, "</", top.element->name, ">\n");
+                if (top.capture_from != not_captured) {
+                    fragments.emplace(fragment_key(top.hash, top.indent),
+                                      Fragment{top.hash, *top.element, out.substr(top.capture_from)});
+                }
+                stack.pop_back();
+            }
+        }
+    }
+};
+
+// Renders the same bytes as HtmlElement::render() on several threads. A
+// first pass measures every subtree's output size, which gives each
+// subtree a disjoint range of the output; subtrees are then rendered into
+// their ranges concurrently. A subtree bigger than `grain` bytes is split:
+// its task writes the element's own lines and queues one task per child.
+// Tasks run on a work-stealing pool: each thread takes its newest task
+// from its own queue and steals the oldest from another's when it runs
+// dry. The calling thread is one of the `threads`; the others are started
+// by the constructor and sleep between renders. An exception on any thread
+// stops the render and is rethrown by render() once every worker is idle.
+// One render() at a time.
+class ParallelHtmlRenderer {
+    size_t threads, grain;
+
+    // Writes into a range of the output.
+    struct RangeWriter {
+        char* at;
+        void append(const char* data, size_t n) {
+            std::memcpy(at, data, n);
+            at += n;
+        }
+    };
+
+    struct Task {
+        const HtmlElement* element;
+        uint32_t index; // pre-order
+        size_t indent;
+        size_t offset;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // per node in pre-order
+    std::vector<size_t> bytes;
+    std::vector<uint32_t> subtree_sizes;
+
+    // the current render
+    std::vector<Queue> queues;
+    char* out = nullptr;
+    std::atomic<size_t> pending{0};
+    std::atomic<bool> failed{false};
+    std::exception_ptr failure; // the first one, under state_mutex
+
+    std::mutex state_mutex;
+    std::condition_variable wake, idle;
+    uint64_t generation = 0; // bumped to start a render
+    size_t busy = 0;         // workers still in the current render
+    bool stopping = false;
+    std::vector<std::thread> workers;
+
+public:
+    explicit ParallelHtmlRenderer(size_t threads, size_t grain = 64 * 1024)
+        : threads(std::max<size_t>(threads, 1)), grain(grain), queues(this->threads) {
+        try {
+            for (size_t t = 1; t < this->threads; ++t) workers.emplace_back(&ParallelHtmlRenderer::work, this, t);
+        } catch (...) {
+            stop();
+            throw;
+        }
+    }
+    ParallelHtmlRenderer(const ParallelHtmlRenderer&) = delete;
+    ParallelHtmlRenderer& operator=(const ParallelHtmlRenderer&) = delete;
+    ~ParallelHtmlRenderer() { stop(); }
+
+    std::string render(const HtmlElement& root) {
+        measure(root);
+        std::string out(bytes[0], '\0');
+        render_into(root, out.data());
+        return out;
+    }
+
+private:
+    void measure(const HtmlElement& root) {
+        bytes.clear();
+        subtree_sizes.clear();
+        std::vector<uint32_t> open;
+        root.walk(0,
+            [&](const HtmlElement& e, size_t indent) {
+                open.push_back(static_cast<uint32_t>(bytes.size()));
+                bytes.push_back(opening_size(e, indent) + closing_size(e, indent));
+                subtree_sizes.push_back(0);
+            },
+            [&](const HtmlElement&, size_t) {
+                uint32_t index = open.back();
+                open.pop_back();
+                subtree_sizes[index] = static_cast<uint32_t>(bytes.size() - index);
+                if (!open.empty()) bytes[open.back()] += bytes[index];
+            });
+    }
+
+    static size_t opening_size(const HtmlElement& e, size_t indent) {
+        return indent + e.name.size() + 3 + (e.text.empty() ? 0 : indent + e.indent_spaces + e.text.size() + 1);
+    }
+    static size_t closing_size(const HtmlElement& e, size_t indent) { return indent + e.name.size() + 4; }
+
+    void render_into(const HtmlElement& root, char* target) {
+        for (auto& queue : queues) queue.tasks.clear(); // left over by a failed render
+        out = target;
+        failed.store(false, std::memory_order_relaxed);
+        pending.store(1, std::memory_order_relaxed);
+        queues[0].tasks.push_back({&root, 0, 0, 0});
+        {
+            std::lock_guard lock(state_mutex);
+            failure = nullptr;
+            busy = workers.size();
+            ++generation;
+        }
+        wake.notify_all();
+        run(0);
+
+        std::unique_lock lock(state_mutex);
+        idle.wait(lock, [this] { return busy == 0; });
+        if (failure) std::rethrow_exception(failure);
+    }
+
+    void work(size_t me) {
+        uint64_t seen = 0;
+        std::unique_lock lock(state_mutex);
+        while (true) {
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+            lock.unlock();
+            run(me);
+            lock.lock();
+            if (--busy == 0) idle.notify_all();
+        }
+    }
+
+    void run(size_t me) {
+        Task task;
+        while (!failed.load(std::memory_order_acquire)) {
+            if (take(queues, me, task)) {
+                try {
+                    execute(task, out, queues[me], pending);
+                } catch (...) {
+                    std::lock_guard lock(state_mutex);
+                    if (!failure) failure = std::current_exception();
+                    failed.store(true, std::memory_order_release);
+                }
+                pending.fetch_sub(1, std::memory_order_acq_rel);
+            } else if (pending.load(std::memory_order_acquire) == 0) {
+                return;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void stop() {
+        {
+            std::lock_guard lock(state_mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& worker : workers) worker.join();
+        workers.clear();
+    }
+
+    // Own queue newest first, then the oldest task of the others.
+    static bool take(std::vector<Queue>& queues, size_t me, Task& task) {
+        {
+            std::lock_guard lock(queues[me].mutex);
+            if (!queues[me].tasks.empty()) {
+                task = queues[me].tasks.back();
+                queues[me].tasks.pop_back();
+                return true;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); ++i) {
+            Queue& victim = queues[(me + i) % queues.size()];
+            std::lock_guard lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void execute(const Task& task, char* out, Queue& own, std::atomic<size_t>& pending) {
+        const HtmlElement& e = *task.element;
+        if (bytes[task.index] <= grain || e.elements.empty()) {
+            RangeWriter writer{out + task.offset};
+            e.render_to(writer, static_cast<int>(task.indent));
+            return;
+        }
+        RangeWriter writer{out + task.offset};
+        line(writer, task.indent, "<", e.name, ">\n");
+        if (!e.text.empty()) line(writer, task.indent + e.indent_spaces, "", e.text, "\n");
+
+        size_t offset = task.offset + opening_size(e, task.indent);
+        uint32_t index = task.index + 1;
+        std::vector<Task> children;
+        children.reserve(e.elements.size());
+        for (const auto& child : e.elements) {
+            children.push_back({&child, index, task.indent + e.indent_spaces, offset});
+            offset += bytes[index];
+            index += subtree_sizes[index];
+        }
+        pending.fetch_add(children.size(), std::memory_order_acq_rel);
+        {
+            std::lock_guard lock(own.mutex);
+            // reversed, so this thread takes the first child next
+            own.tasks.insert(own.tasks.end(), children.rbegin(), children.rend());
+        }
+        RangeWriter closing{out + offset};
+        line(closing, task.indent, "</", e.name, ">\n");
+    }
+
+    static void line(RangeWriter& out, size_t spaces, std::string_view a, std::string_view b, std::string_view c) {
+        append_spaces(out, spaces);
+        out.append(a.data(), a.size());
+        out.append(b.data(), b.size());
+        out.append(c.data(), c.size());
+    }
+};
+
+// The tree is only changed through the builder, so the fragment cache
+// always knows when to rehash.
 struct HtmlBuilder {
-    HtmlElement root;
+private:
+    HtmlElement tree;
+    HtmlFragmentCache fragments;
 
-    operator HtmlElement() const { return root; }
+public:
+    const HtmlElement& root() const { return tree; }
+    operator HtmlElement() const { return tree; }
 
-    HtmlBuilder(const std::string& root_name) { root.name = root_name; }
+    HtmlBuilder(const std::string& root_name) { tree.name = root_name; }
 
     HtmlBuilder& add_child([[maybe_unused]] const std::string& child_name,  [[maybe_unused]] const std::string& child_text) {
         HtmlElement e(child_name, child_text);
-        root.elements.emplace_back(e);
+        tree.elements.emplace_back(e);
+        fragments.invalidate();
+        return *this;
+    }
+
+    // Adds a whole subtree under the root.
+    HtmlBuilder& add_child(HtmlElement child) {
+        tree.elements.push_back(std::move(child));
+        fragments.invalidate();
+        return *this;
+    }
+
+    // Any other change: f(root) edits the tree in place.
+    template <typename F>
+    HtmlBuilder& edit(F&& f) {
+        fragments.invalidate();
+        std::forward<F>(f)(tree);
+        return *this;
+    }
+
+    std::string str() const { return tree.str(); }
+
+    // Same bytes as str(), with repeated subtrees rendered once.
+    std::string render() { return fragments.render(tree); }
+    size_t fragment_count() const { return fragments.fragment_count(); }
+};
+
+// An HTML tree held in a few arena blocks instead of per-node containers.
+// Nodes live in blocks that double in size (so ids stay valid and nothing
+// is copied as the tree grows), names and text are bump-allocated, and
+// children and attributes are linked by index. Building N nodes costs O(N)
+// with O(log N) allocations.
+class HtmlDocument {
+public:
+    using node_id = uint32_t;
+    static constexpr node_id no_node = std::numeric_limits<node_id>::max();
+
+    struct Node {
+        std::string_view name, text;
+        node_id first_child = no_node, last_child = no_node, next_sibling = no_node;
+        uint32_t first_attribute = no_node, last_attribute = no_node;
+    };
+
+    struct Attribute {
+        std::string_view name, value;
+        uint32_t next = no_node;
+    };
+
+    // The attributes of one node, as name/value pairs.
+    class AttributeRange {
+        const HtmlDocument* document;
+        uint32_t first;
+
+    public:
+        class iterator {
+            const HtmlDocument* document;
+            uint32_t at;
+
+        public:
+            iterator(const HtmlDocument* document, uint32_t at) : document(document), at(at) { }
+            std::pair<std::string_view, std::string_view> operator*() const {
+                const Attribute& a = document->attributes[at];
+                return {a.name, a.value};
+            }
+            iterator& operator++() {
+                at = document->attributes[at].next;
+                return *this;
+            }
+            bool operator!=(const iterator& other) const { return at != other.at; }
+        };
+
+        AttributeRange(const HtmlDocument* document, uint32_t first) : document(document), first(first) { }
+        iterator begin() const { return {document, first}; }
+        iterator end() const { return {document, no_node}; }
+    };
+
+    explicit HtmlDocument(std::string_view root_name, size_t text_block = 64 * 1024)
+        : text_bytes(text_block) { new_node(root_name, {}); }
+    HtmlDocument(const HtmlDocument&) = delete;
+    HtmlDocument& operator=(const HtmlDocument&) = delete;
+
+    node_id root() const { return 0; }
+    size_t size() const { return count; }
+    const Node& operator[](node_id id) const { return node(id); }
+    AttributeRange attributes_of(node_id id) const { return {this, node(id).first_attribute}; }
+
+    // Appends a new last child to `parent`.
+    node_id add_child(node_id parent, std::string_view name, std::string_view text = {}) {
+        node_id id = new_node(name, text);
+        Node& p = node(parent);
+        if (p.last_child == no_node) p.first_child = id;
+        else node(p.last_child).next_sibling = id;
+        p.last_child = id;
+        return id;
+    }
+
+    void set_text(node_id id, std::string_view text) { node(id).text = store(text); }
+
+    void add_attribute(node_id id, std::string_view name, std::string_view value) {
+        auto index = static_cast<uint32_t>(attributes.size());
+        attributes.push_back({store(name), store(value)});
+        Node& n = node(id);
+        if (n.last_attribute == no_node) n.first_attribute = index;
+        else attributes[n.last_attribute].next = index;
+        n.last_attribute = index;
+    }
+
+    // Copies a Tag tree under `parent`; returns the copy of `tag`.
+    node_id add_tree(node_id parent, const Tag& tag) {
+        std::vector<std::pair<const Tag*, node_id>> pending{{&tag, parent}};
+        node_id top = no_node;
+        while (!pending.empty()) {
+            auto [t, under] = pending.back();
+            pending.pop_back();
+            node_id id = add_child(under, t->name, t->text);
+            if (top == no_node) top = id;
+            for (const auto& [name, value] : t->attributes) add_attribute(id, name, value);
+            // reversed, so children are added in order
+            for (auto child = t->children.rbegin(); child != t->children.rend(); ++child) {
+                pending.emplace_back(&*child, id);
+            }
+        }
+        return top;
+    }
+
+    // Pretty-printed like HtmlElement::str(), attributes included.
+    std::string str() const {
+        std::string out;
+        render_to(out);
+        return out;
+    }
+
+    template <typename Out>
+    void render_to(Out& out) const {
+        auto put = [&out](std::string_view s) { out.append(s.data(), s.size()); };
+        auto open = [&](node_id id, size_t depth) {
+            const Node& n = node(id);
+            append_spaces(out, depth * indent_spaces);
+            put("<");
+            put(n.name);
+            for (auto [name, value] : attributes_of(id)) {
+                put(" ");
+                put(name);
+                put("=\"");
+                put(value);
+                put("\"");
+            }
+            put(">\n");
+            if (!n.text.empty()) {
+                append_spaces(out, (depth + 1) * indent_spaces);
+                put(n.text);
+                put("\n");
+            }
+        };
+        auto close = [&](node_id id, size_t depth) {
+            append_spaces(out, depth * indent_spaces);
+            put("</");
+            put(node(id).name);
+            put(">\n");
+        };
+        walk(open, close);
+    }
+
+    // Compact and escaped, like write_html for a Tag.
+    template <typename Out>
+    void write_html_to(Out& out) const {
+        node_id void_element = no_node; // has no children, so it closes right after opening
+        auto open = [&](node_id id, size_t) {
+            const Node& n = node(id);
+            if (!write_start_tag(out, n.name, attributes_of(id), n.text, n.first_child != no_node)) void_element = id;
+        };
+        walk(open, [&](node_id id, size_t) {
+            if (id != void_element) write_end_tag(out, node(id).name);
+        });
+    }
+
+private:
+    static constexpr size_t indent_spaces = 2;
+    static constexpr size_t first_block = 1024;
+
+    std::pmr::monotonic_buffer_resource text_bytes;
+    struct BlockDelete {
+        void operator()(Node* block) const { ::operator delete(block); }
+    };
+    // block k holds first_block << k nodes, constructed as they are added
+    // so untouched pages of the newest block stay unmapped
+    std::vector<std::unique_ptr<Node, BlockDelete>> blocks;
+    size_t count = 0;
+    std::vector<Attribute> attributes;
+
+    std::string_view store(std::string_view s) {
+        if (s.empty()) return {};
+        auto* p = static_cast<char*>(text_bytes.allocate(s.size(), 1));
+        std::memcpy(p, s.data(), s.size());
+        return {p, s.size()};
+    }
+
+    static std::pair<size_t, size_t> locate(node_id id) {
+        size_t i = size_t{id} + first_block;
+        size_t k = static_cast<size_t>(std::bit_width(i) - std::bit_width(first_block));
+        return {k, i - (first_block << k)};
+    }
+
+    Node& node(node_id id) const {
+        auto [k, offset] = locate(id);
+        return blocks[k].get()[offset];
+    }
+
+    node_id new_node(std::string_view name, std::string_view text) {
+        if (count == no_node) throw std::length_error("HtmlDocument full");
+        auto id = static_cast<node_id>(count++);
+        auto [k, offset] = locate(id);
+        if (k == blocks.size()) {
+            blocks.emplace_back(static_cast<Node*>(::operator new(sizeof(Node) * (first_block << k))));
+        }
+        new (blocks[k].get() + offset) Node{store(name), store(text)};
+        return id;
+    }
+
+    // open(id, depth) in document order, close(id, depth) after the
+    // children; an explicit stack of the next child to visit per level.
+    template <typename Open, typename Close>
+    void walk(Open&& open, Close&& close) const {
+        std::vector<node_id> next{node(root()).first_child};
+        open(root(), 0);
+        std::vector<node_id> path{root()};
+        while (!path.empty()) {
+            node_id child = next.back();
+            if (child == no_node) {
+                close(path.back(), path.size() - 1);
+                path.pop_back();
+                next.pop_back();
+            } else {
+                next.back() = node(child).next_sibling;
+                open(child, path.size());
+                path.push_back(child);
+                next.push_back(node(child).first_child);
+            }
+        }
+    }
+};
+
+// Fluent front end with HtmlBuilder's shape, over an HtmlDocument.
+struct HtmlDocumentBuilder {
+    HtmlDocument document;
+
+    explicit HtmlDocumentBuilder(std::string_view root_name) : document(root_name) { }
+
+    HtmlDocumentBuilder& add_child(std::string_view child_name, std::string_view child_text) {
+        document.add_child(document.root(), child_name, child_text);
+        return *this;
+    }
+
+    HtmlDocumentBuilder& with_attribute(std::string_view name, std::string_view value) {
+        auto last = document[document.root()].last_child;
+        document.add_attribute(last == HtmlDocument::no_node ? document.root() : last, name, value);
+        return *this;
+    }
+
+    std::string str() const { return document.str(); }
+};
+
+// Builds nested elements in document order: open() starts a child of the
+// current element and moves into it, text() sets the current element's
+// text (before any of its children), close() moves back up. Without a sink
+// the tree is built in place in an HtmlDocument. With one, output in
+// HtmlElement::str() format is written as the tree is described, and only
+// the names of the open elements are kept.
+class HtmlCursorBuilder {
+    std::optional<HtmlDocument> document;
+    std::optional<ChunkedOutput> out;
+
+    struct Level {
+        HtmlDocument::node_id id; // in the document
+        size_t name_end;          // in open_names, when streaming
+        bool has_children = false;
+        bool has_text = false;
+    };
+    std::vector<Level> levels;
+    std::string open_names;
+
+    static constexpr size_t indent_spaces = 2;
+
+public:
+    explicit HtmlCursorBuilder(std::string_view root_name, std::ostream* sink = nullptr) {
+        if (sink) {
+            out.emplace(64 * 1024, sink);
+            open_names.assign(root_name);
+            levels.push_back({HtmlDocument::no_node, open_names.size()});
+            write_line("<", root_name, ">\n", 0);
+        } else {
+            document.emplace(root_name);
+            levels.push_back({document->root(), 0});
+        }
+    }
+    HtmlCursorBuilder(const HtmlCursorBuilder&) = delete;
+    HtmlCursorBuilder& operator=(const HtmlCursorBuilder&) = delete;
+    ~HtmlCursorBuilder() {
+        if (out) finish();
+    }
+
+    HtmlCursorBuilder& open(std::string_view name) {
+        Level& parent = current();
+        parent.has_children = true;
+        if (out) {
+            write_line("<", name, ">\n", levels.size());
+            open_names.append(name);
+            levels.push_back({HtmlDocument::no_node, open_names.size()});
+        } else {
+            levels.push_back({document->add_child(parent.id, name), 0});
+        }
+        return *this;
+    }
+
+    HtmlCursorBuilder& text(std::string_view text) {
+        Level& level = current();
+        if (level.has_text || level.has_children)
+            throw std::logic_error("text must come once, before the element's children");
+        level.has_text = true;
+        if (text.empty()) return *this;
+        if (out) write_line("", text, "\n", levels.size());
+        else document->set_text(level.id, text);
+        return *this;
+    }
+
+    HtmlCursorBuilder& close() {
+        current();
+        if (out) {
+            size_t name_begin = levels.size() > 1 ? levels[levels.size() - 2].name_end : 0;
+            write_line("</", std::string_view(open_names).substr(name_begin), ">\n", levels.size() - 1);
+            open_names.resize(name_begin);
+        }
+        levels.pop_back();
         return *this;
     }
 
-    std::string str() const { return root.str(); }
+    // HtmlBuilder's add_child, for a leaf under the current element.
+    HtmlCursorBuilder& add_child(std::string_view child_name, std::string_view child_text) {
+        return open(child_name).text(child_text).close();
+    }
+
+    // Elements open, the root included.
+    size_t depth() const { return levels.size(); }
+
+    // Streaming: closes what is still open and flushes the sink.
+    void finish() {
+        while (!levels.empty()) close();
+        if (out) out->flush();
+    }
+
+    // The tree built so far; only without a sink.
+    const HtmlDocument& tree() const {
+        if (!document) throw std::logic_error("a streaming HtmlCursorBuilder keeps no tree");
+        return *document;
+    }
+
+    std::string str() const { return tree().str(); }
+
+private:
+    Level& current() {
+        if (levels.empty()) throw std::logic_error("the root element is already closed");
+        return levels.back();
+    }
+
+    void write_line(std::string_view a, std::string_view b, std::string_view c, size_t depth) {
+        append_spaces(*out, depth * indent_spaces);
+        out->append(a);
+        out->append(b);
+        out->append(c);
+    }
 };
 
 TEST(HtmlBuilderTest, BuildSimpleList) {
@@ -137,6 +1178,478 @@ TEST(HtmlBuilderTest, EmptyElement) {
     EXPECT_EQ(html.str(), expected);
 }
 
+static HtmlElement element(const std::string& name, const std::string& text = "") {
+    HtmlElement e = HtmlBuilder(name);
+    e.text = text;
+    return e;
+}
+
+// `depth` nested divs, each with a line of text.
+static HtmlElement deep_tree(size_t depth) {
+    HtmlElement root = element("div", "level 0");
+    HtmlElement* at = &root;
+    for (size_t d = 1; d < depth; ++d) {
+        at->elements.push_back(element("div", "level " + std::to_string(d)));
+        at = &at->elements.back();
+    }
+    return root;
+}
+
+// A root with `width` list items, every tenth holding a nested list.
+static HtmlElement wide_tree(size_t width) {
+    HtmlElement root = element("ul");
+    root.elements.reserve(width);
+    for (size_t i = 0; i < width; ++i) {
+        root.elements.push_back(element("li", "item " + std::to_string(i)));
+        if (i % 10 == 0) {
+            auto& sub = root.elements.back().elements.emplace_back(element("ul"));
+            sub.elements.push_back(element("li", "nested"));
+            sub.elements.push_back(element("li"));
+        }
+    }
+    return root;
+}
+
+TEST(HtmlRenderTest, MatchesStr) {
+    auto html = (*HtmlElement::build("ul")).add_child("li", "hello").add_child("li", "world");
+    EXPECT_EQ(html.root().render(), html.str());
+    EXPECT_EQ(element("div").render(), element("div").str());
+
+    for (const HtmlElement& tree : {wide_tree(100), deep_tree(300)}) {
+        EXPECT_EQ(tree.render(), tree.str());
+        EXPECT_EQ(tree.render(3), tree.str(3));
+        EXPECT_EQ(tree.rendered_size(), tree.str().size());
+    }
+}
+
+TEST(HtmlRenderTest, RendersVeryDeepTrees) {
+    HtmlElement tree = deep_tree(10'000);
+    std::string html = tree.render();
+    EXPECT_EQ(html.size(), tree.rendered_size());
+    EXPECT_TRUE(html.starts_with("<div>\n  level 0\n  <div>\n"));
+    EXPECT_TRUE(html.ends_with("  </div>\n</div>\n"));
+}
+
+static std::string html_of(const Tag& tag) {
+    std::string out;
+    write_html(out, tag);
+    return out;
+}
+
+TEST(TagTest, WriteHtmlEscapesAndClosesVoidElements) {
+    P p{IMG{"http://pokemon.com/pikachu.png?a=1&b=\"2\""}, P{"Pikachu <3 & friends, 'quoted'"}};
+    EXPECT_EQ(html_of(p), "<p><img src=\"http://pokemon.com/pikachu.png?a=1&amp;b=&quot;2&quot;\">"
+                          "<p>Pikachu &lt;3 &amp; friends, 'quoted'</p></p>");
+
+    P plain{P{"hello"}, P{"world"}};
+    std::stringstream ss;
+    ss << plain;
+    EXPECT_EQ(html_of(plain), ss.str());
+
+    // every position within and across the 8-byte words
+    std::string text(37, 'x');
+    for (size_t i = 0; i < text.size(); ++i) {
+        std::string s = text;
+        s[i] = '<';
+        EXPECT_EQ(html_of(P{s}), "<p>" + text.substr(0, i) + "&lt;" + text.substr(i + 1) + "</p>");
+    }
+}
+
+TEST(TagTest, WriteHtmlHandlesDeepTreesInChunks) {
+    const size_t depth = 10'000;
+    P root{"0"};
+    Tag* at = &root;
+    for (size_t d = 1; d < depth; ++d) {
+        at->children.push_back(P{std::to_string(d % 10)});
+        at = &at->children.back();
+    }
+    std::ostringstream sink;
+    {
+        ChunkedOutput out(100, &sink);
+        write_html(out, root);
+        EXPECT_EQ(out.size(), depth * 8);
+    }
+    std::ostringstream expected;
+    expected << root;
+    EXPECT_EQ(sink.str(), expected.str());
+
+    ChunkedOutput in_memory(7);
+    write_html(in_memory, root);
+    EXPECT_EQ(in_memory.str(), expected.str());
+}
+
+TEST(HtmlDocumentTest, BuilderMatchesHtmlBuilder) {
+    auto html = (*HtmlElement::build("ul")).add_child("li", "hello").add_child("li", "world");
+    HtmlDocumentBuilder document("ul");
+    document.add_child("li", "hello").add_child("li", "world");
+    EXPECT_EQ(document.str(), html.str());
+    EXPECT_EQ(HtmlDocumentBuilder("div").str(), "<div>\n</div>\n");
+
+    HtmlElement tree = wide_tree(50);
+    HtmlDocument copy(tree.name, 16);
+    std::vector<std::pair<const HtmlElement*, HtmlDocument::node_id>> pending;
+    for (const auto& e : tree.elements) pending.emplace_back(&e, copy.root());
+    for (size_t i = 0; i < pending.size(); ++i) {
+        auto [e, parent] = pending[i];
+        auto id = copy.add_child(parent, e->name, e->text);
+        for (const auto& child : e->elements) pending.emplace_back(&child, id);
+    }
+    EXPECT_EQ(copy.str(), tree.str());
+    EXPECT_EQ(copy.size(), size_t(1 + 50 + 5 * 3));
+}
+
+TEST(HtmlDocumentTest, HoldsTagTrees) {
+    P p{IMG{"http://pokemon.com/pikachu.png?a&b"}, P{"<hello>"}, P{P{"deep"}}};
+    HtmlDocument document("body");
+    document.add_tree(document.root(), p);
+    std::string out;
+    document.write_html_to(out);
+    EXPECT_EQ(out, "<body>" + html_of(p) + "</body>");
+
+    HtmlDocumentBuilder with_image("p");
+    with_image.add_child("img", "").with_attribute("src", "pikachu.png");
+    EXPECT_EQ(with_image.str(), "<p>\n  <img src=\"pikachu.png\">\n  </img>\n</p>\n");
+}
+
+// A page with nested lists and a 1000-level chain, described to a cursor.
+static void describe_page(HtmlCursorBuilder& html) {
+    html.open("head").add_child("title", "Pokedex").close();
+    html.open("body");
+    for (int s = 0; s < 20; ++s) {
+        html.open("ul").text("section " + std::to_string(s));
+        for (int i = 0; i < 5; ++i) html.open("li").text("item").add_child("span", "detail").close();
+        html.close();
+    }
+    for (int d = 0; d < 1'000; ++d) html.open("div");
+    html.text("bottom");
+    for (int d = 0; d < 1'000; ++d) html.close();
+    html.close();
+}
+
+TEST(HtmlCursorBuilderTest, StreamsWhatItWouldBuild) {
+    HtmlCursorBuilder built("html");
+    describe_page(built);
+    EXPECT_EQ(built.depth(), size_t(1));
+
+    std::ostringstream sink;
+    {
+        HtmlCursorBuilder streamed("html", &sink);
+        describe_page(streamed);
+        EXPECT_THROW(streamed.tree(), std::logic_error);
+    }
+    EXPECT_EQ(sink.str(), built.str());
+    EXPECT_EQ(built.tree().size(), size_t(1 + 2 + 1 + 20 * 11 + 1'000));
+
+    auto html = (*HtmlElement::build("ul")).add_child("li", "hello").add_child("li", "world");
+    HtmlCursorBuilder cursor("ul");
+    cursor.add_child("li", "hello").add_child("li", "world");
+    EXPECT_EQ(cursor.str(), html.str());
+}
+
+TEST(HtmlCursorBuilderTest, RejectsMisplacedTextAndExtraClose) {
+    HtmlCursorBuilder html("div");
+    html.open("p").open("b").close();
+    EXPECT_THROW(html.text("after a child"), std::logic_error);
+    html.close().close();
+    EXPECT_THROW(html.close(), std::logic_error);
+    EXPECT_EQ(html.str(), "<div>\n  <p>\n    <b>\n    </b>\n  </p>\n</div>\n");
+}
+
+// A card: a list item holding an image, a caption and a nested list.
+static HtmlElement card(const std::string& caption) {
+    HtmlElement item = element("li", caption);
+    item.elements.push_back(element("img", "pikachu.png"));
+    HtmlElement details = element("ul");
+    for (const char* d : {"Electric", "0.4 m", "6.0 kg"}) details.elements.push_back(element("li", d));
+    item.elements.push_back(std::move(details));
+    return item;
+}
+
+// `cards` cards in nested sections; `repeated_percent` of them are one of
+// ten shared templates, the rest unique.
+static HtmlBuilder card_page(size_t cards, size_t repeated_percent) {
+    HtmlBuilder page("body");
+    for (size_t s = 0; s < cards / 100; ++s) {
+        HtmlElement section = element("ul", "section");
+        for (size_t i = 0; i < 100; ++i) {
+            bool repeated = i < repeated_percent;
+            section.elements.push_back(card(repeated ? "Pikachu " + std::to_string(i % 10)
+                                                     : "Card " + std::to_string(s * 100 + i)));
+        }
+        page.add_child(std::move(section));
+    }
+    return page;
+}
+
+TEST(HtmlFragmentCacheTest, RendersLikeStrAndReusesFragments) {
+    HtmlBuilder page = card_page(300, 90);
+    std::string expected = page.str();
+    EXPECT_EQ(page.render(), expected);
+    size_t stored = page.fragment_count();
+    EXPECT_GT(stored, size_t(10));
+    EXPECT_EQ(page.render(), expected);
+    EXPECT_EQ(page.fragment_count(), stored);
+
+    // the second card comes whole from the store, so its nested list isn't
+    // stored again; single elements are never stored
+    HtmlBuilder repeated("ul");
+    repeated.add_child("li", "same").add_child("li", "same").add_child(card("same")).add_child(card("same"));
+    EXPECT_EQ(repeated.render(), repeated.str());
+    EXPECT_EQ(repeated.fragment_count(), size_t(2));
+}
+
+TEST(HtmlFragmentCacheTest, MutatingTheBuilderInvalidates) {
+    HtmlBuilder page("ul");
+    page.add_child("li", "a").add_child("li", "a");
+    EXPECT_EQ(page.render(), page.str());
+
+    page.add_child("li", "b").add_child(card("Pikachu")).add_child(card("Pikachu"));
+    EXPECT_EQ(page.render(), page.str());
+    EXPECT_EQ(page.fragment_count(), size_t(2)); // the card and its details list
+
+    // same shape, different text: the cards stop repeating and their
+    // fragment is dropped, the details lists still repeat
+    page.edit([](HtmlElement& root) { root.elements[3].elements[0].text = "raichu.png"; });
+    EXPECT_EQ(page.render(), page.str());
+    EXPECT_EQ(page.fragment_count(), size_t(1));
+
+    HtmlBuilder copy = page;
+    copy.add_child("li", "c");
+    EXPECT_EQ(copy.render(), copy.str());
+    EXPECT_EQ(page.render(), page.str());
+}
+
+TEST(ParallelHtmlRendererTest, MatchesSequentialOutput) {
+    HtmlElement page = card_page(500, 50).root();
+    page.elements.push_back(deep_tree(500));
+    page.elements.push_back(wide_tree(300));
+    const std::string expected = page.render();
+    for (size_t threads : {1, 2, 4, 8}) {
+        for (size_t grain : {64, 4096, 1 << 20}) {
+            EXPECT_EQ(ParallelHtmlRenderer(threads, grain).render(page), expected)
+                << threads << " threads, grain " << grain;
+        }
+    }
+    EXPECT_EQ(ParallelHtmlRenderer(4, 1).render(element("div", "only")), element("div", "only").str());
+}
+
+TEST(ParallelHtmlRendererTest, ReusesItsThreadsAcrossRenders) {
+    ParallelHtmlRenderer renderer(4, 256);
+    for (size_t cards : {300, 0, 1000, 100}) {
+        HtmlElement page = card_page(cards, 50).root();
+        EXPECT_EQ(renderer.render(page), page.render()) << cards << " cards";
+    }
+    EXPECT_EQ(renderer.render(deep_tree(200)), deep_tree(200).render());
+}
+
+// Benchmarks are disabled by default, run them with:
+//   ./simple_web_page --gtest_also_run_disabled_tests --gtest_filter='HtmlBenchmark.*'
+// str() re-copies every subtree into its parent, so on deep trees it is
+// only timed up to 2k levels.
+TEST(HtmlBenchmark, DISABLED_RenderVsStr) {
+    auto compare = [](const std::string& label, const HtmlElement& tree, bool with_str) {
+        auto t0 = bench_clock::now();
+        std::string rendered = tree.render();
+        double render_ms = elapsed_ms(t0);
+        std::cout << label << " (" << rendered.size() / 1024 << " KB): render " << render_ms << " ms";
+        if (with_str) {
+            t0 = bench_clock::now();
+            std::string expected = tree.str();
+            double str_ms = elapsed_ms(t0);
+            EXPECT_EQ(rendered, expected);
+            std::cout << ", str " << str_ms << " ms (" << str_ms / render_ms << "x)";
+        }
+        std::cout << "\n";
+    };
+    compare("wide, 100k items", wide_tree(bench_size("HTML_BENCH_WIDTH", 100'000)), true);
+    for (size_t depth : {500, 1'000, 2'000}) {
+        compare("deep, " + std::to_string(depth) + " levels", deep_tree(depth), true);
+    }
+    compare("deep, 10k levels", deep_tree(10'000), false);
+}
+
+// A synthetic document of about HTML_BENCH_MB (default 100) MB: sections
+// of text needing some escaping, images and nested paragraphs.
+TEST(HtmlBenchmark, DISABLED_WriteHtmlThroughput) {
+    const size_t target = bench_size("HTML_BENCH_MB", 100) << 20;
+    P section{IMG{"http://pokemon.com/pikachu.png?size=large&format=png"},
+              P{"Pikachu is an Electric-type Pokemon introduced in Generation I. It evolves from Pichu "
+                "when leveled up with high friendship & evolves into Raichu when exposed to a Thunder Stone."},
+              P{P{"Height: 0.4 m"}, P{"Weight: 6.0 kg"}, P{"Ability: Static <hidden: Lightning Rod>"}}};
+    P document{P{"Pokedex"}};
+    const size_t per_section = html_of(section).size();
+    document.children.assign(target / per_section, section);
+
+    ChunkedOutput in_memory;
+    auto t0 = bench_clock::now();
+    write_html(in_memory, document);
+    double ms = elapsed_ms(t0);
+    const double mb = static_cast<double>(in_memory.size()) / (1 << 20);
+    std::cout << mb << " MB document\n";
+    std::cout << "write_html, chunked in memory: " << mb / ms * 1000 << " MB/s\n";
+
+    std::ofstream devnull("/dev/null");
+    t0 = bench_clock::now();
+    {
+        ChunkedOutput streamed(64 * 1024, &devnull);
+        write_html(streamed, document);
+    }
+    std::cout << "write_html, streamed to a file: " << mb / elapsed_ms(t0) * 1000 << " MB/s\n";
+
+    std::string contiguous;
+    t0 = bench_clock::now();
+    write_html(contiguous, document);
+    std::cout << "write_html, into one std::string: " << mb / elapsed_ms(t0) * 1000 << " MB/s\n";
+
+    t0 = bench_clock::now();
+    std::ostringstream os;
+    os << document;
+    std::cout << "operator<< (no escaping): " << os.str().size() / double(1 << 20) / elapsed_ms(t0) * 1000
+              << " MB/s\n";
+}
+
+// HTML_BENCH_NODES (default 10M) nodes as sections of nine list items.
+// Run the two cases in separate processes so peak RSS is per case.
+TEST(HtmlBenchmark, DISABLED_BuildHtmlElementTree) {
+    const size_t sections = bench_size("HTML_BENCH_NODES", 10'000'000) / 10;
+    auto t0 = bench_clock::now();
+    auto builder = HtmlElement::build("body");
+    for (size_t s = 0; s < sections; ++s) {
+        HtmlElement section = element("ul");
+        for (int i = 0; i < 9; ++i) section.elements.push_back(element("li", "list item text"));
+        builder->add_child(std::move(section));
+    }
+    double ms = elapsed_ms(t0);
+    std::cout << "HtmlElement: " << static_cast<long>(sections * 10 / ms * 1000) << " nodes/sec, peak RSS "
+              << peak_rss_kb() / 1024 << " MB\n";
+}
+
+TEST(HtmlBenchmark, DISABLED_BuildHtmlDocument) {
+    const size_t sections = bench_size("HTML_BENCH_NODES", 10'000'000) / 10;
+    auto t0 = bench_clock::now();
+    HtmlDocumentBuilder builder("body");
+    HtmlDocument& document = builder.document;
+    for (size_t s = 0; s < sections; ++s) {
+        builder.add_child("ul", "");
+        auto section = document[document.root()].last_child;
+        for (int i = 0; i < 9; ++i) document.add_child(section, "li", "list item text");
+    }
+    double ms = elapsed_ms(t0);
+    std::cout << "HtmlDocument: " << static_cast<long>(sections * 10 / ms * 1000) << " nodes/sec, peak RSS "
+              << peak_rss_kb() / 1024 << " MB\n";
+}
+
+// HTML_BENCH_SECTIONS (default 100k) sections, each a div holding a list
+// of eight items with a span (18 nodes): built as HtmlElements then str(),
+// with the cursor into an HtmlDocument then str(), and streamed.
+TEST(HtmlBenchmark, DISABLED_CursorBuilderVsBuildThenStr) {
+    const size_t sections = bench_size("HTML_BENCH_SECTIONS", 100'000);
+    auto report = [](const char* label, double ms, size_t bytes) {
+        std::cout << label << ": " << ms << " ms (" << bytes / (1 << 20) << " MB)\n";
+    };
+
+    auto t0 = bench_clock::now();
+    HtmlElement body = element("body");
+    for (size_t s = 0; s < sections; ++s) {
+        HtmlElement section = element("div", "section");
+        HtmlElement list = element("ul");
+        for (int i = 0; i < 8; ++i) {
+            HtmlElement item = element("li", "item");
+            item.elements.push_back(element("span", "detail"));
+            list.elements.push_back(std::move(item));
+        }
+        section.elements.push_back(std::move(list));
+        body.elements.push_back(std::move(section));
+    }
+    std::string expected = body.str();
+    report("HtmlElement build + str()", elapsed_ms(t0), expected.size());
+
+    auto describe = [sections](HtmlCursorBuilder& html) {
+        for (size_t s = 0; s < sections; ++s) {
+            html.open("div").text("section").open("ul");
+            for (int i = 0; i < 8; ++i) html.open("li").text("item").add_child("span", "detail").close();
+            html.close().close();
+        }
+    };
+
+    t0 = bench_clock::now();
+    HtmlCursorBuilder built("body");
+    describe(built);
+    std::string html = built.str();
+    report("cursor into HtmlDocument + str()", elapsed_ms(t0), html.size());
+    EXPECT_EQ(html, expected);
+
+    const std::string path = testing::TempDir() + "html_bench_" + std::to_string(::getpid()) + ".html";
+    t0 = bench_clock::now();
+    {
+        std::ofstream file(path, std::ios::binary);
+        HtmlCursorBuilder streamed("body", &file);
+        describe(streamed);
+    }
+    report("cursor streaming to a file", elapsed_ms(t0), expected.size());
+    std::ifstream written(path, std::ios::binary);
+    EXPECT_EQ(std::string(std::istreambuf_iterator<char>(written), {}), expected);
+    std::remove(path.c_str());
+}
+
+// HTML_BENCH_CARDS (default 100k) cards, 90% of them repeats of ten
+// templates: the plain renderer, then the fragment cache on the first
+// render after a mutation (hashing and filling the store) and on a render
+// with everything stored.
+TEST(HtmlBenchmark, DISABLED_FragmentCache) {
+    HtmlBuilder page = card_page(bench_size("HTML_BENCH_CARDS", 100'000), 90);
+
+    auto t0 = bench_clock::now();
+    std::string expected = page.root().render();
+    double plain_ms = elapsed_ms(t0);
+
+    t0 = bench_clock::now();
+    std::string cold = page.render();
+    double cold_ms = elapsed_ms(t0);
+
+    t0 = bench_clock::now();
+    std::string warm = page.render();
+    double warm_ms = elapsed_ms(t0);
+
+    page.edit([](HtmlElement&) { });
+    t0 = bench_clock::now();
+    std::string rehashed = page.render();
+    double rehashed_ms = elapsed_ms(t0);
+
+    EXPECT_EQ(cold, expected);
+    EXPECT_EQ(warm, expected);
+    EXPECT_EQ(rehashed, expected);
+    std::cout << expected.size() / (1 << 20) << " MB page\n"
+              << "HtmlElement::render():             " << plain_ms << " ms\n"
+              << "fragment cache, cold:              " << cold_ms << " ms\n"
+              << "fragment cache, after invalidate:  " << rehashed_ms << " ms\n"
+              << "fragment cache, warm:              " << warm_ms << " ms (" << plain_ms / warm_ms << "x)\n";
+}
+
+// HTML_BENCH_CARDS (default 500k) cards rendered on 1 to 32 threads,
+// against the sequential renderer.
+TEST(HtmlBenchmark, DISABLED_ParallelRender) {
+    HtmlElement page = card_page(bench_size("HTML_BENCH_CARDS", 500'000), 0).root();
+    auto t0 = bench_clock::now();
+    const std::string expected = page.render();
+    const double sequential_ms = elapsed_ms(t0);
+    std::cout << expected.size() / (1 << 20) << " MB page, " << std::thread::hardware_concurrency()
+              << " hardware threads\nsequential render(): " << sequential_ms << " ms\n";
+
+    for (size_t threads : {1, 2, 4, 8, 16, 32}) {
+        ParallelHtmlRenderer renderer(threads);
+        std::cout << threads << " threads:";
+        for (int round = 0; round < 3; ++round) { // the pool's threads are reused
+            t0 = bench_clock::now();
+            std::string html = renderer.render(page);
+            double ms = elapsed_ms(t0);
+            EXPECT_EQ(html, expected);
+            std::cout << " " << ms << " ms (" << sequential_ms / ms << "x)";
+        }
+        std::cout << "\n";
+    }
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
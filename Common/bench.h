@@ -0,0 +1,47 @@
+#pragma once
+
+// Helpers shared by the disabled benchmark tests of every example. Run
+// one RSS-measuring benchmark per process so deltas don't include freed
+// heap.
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+using bench_clock = std::chrono::steady_clock;
+
+inline double elapsed_sec(bench_clock::time_point since) {
+    return std::chrono::duration<double>(bench_clock::now() - since).count();
+}
+
+inline double elapsed_ms(bench_clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(bench_clock::now() - since).count();
+}
+
+inline double elapsed_ns(bench_clock::time_point since) {
+    return std::chrono::duration<double, std::nano>(bench_clock::now() - since).count();
+}
+
+// Problem size from the environment, e.g. BANK_BENCH_ACCOUNTS=1000000.
+inline size_t bench_size(const char* env, size_t fallback) {
+    const char* v = std::getenv(env);
+    return v ? std::strtoull(v, nullptr, 10) : fallback;
+}
+
+inline long current_rss_kb() {
+    std::ifstream statm("/proc/self/statm");
+    long pages = 0, resident = 0;
+    statm >> pages >> resident;
+    return resident * (::sysconf(_SC_PAGESIZE) / 1024);
+}
+
+inline long peak_rss_kb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.starts_with("VmHWM:")) return std::strtol(line.c_str() + 6, nullptr, 10);
+    }
+    return 0;
+}
@@ -2,79 +2,1127 @@
 #include <string>
 #include <vector>
 #include <algorithm> // for std::find_if
+#include <unordered_map>
+#include <string_view>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <fstream>
+#include <atomic>
+#include <thread>
+#include <optional>
+#include <cstdint>
+#include <stdexcept>
+#include <system_error>
+#include <cstring>
+#include <bit>
+#include <limits>
+#include <deque>
+#include <fcntl.h>
+#include <unistd.h>
+#include <csignal>
+#include <sys/resource.h>
 #include <gtest/gtest.h>
+#include "bench.h"
 
 
 struct Person;
 
+// Immutable, reference-counted formatted message ("origin: \"text\"").
+// A broadcast formats it once and every recipient stores a handle to the
+// same bytes.
+class ChatMessage {
+    std::shared_ptr<const std::string> text;
+
+    static const std::string& empty() {
+        static const std::string none;
+        return none;
+    }
+
+public:
+    ChatMessage() = default; // empty message, no allocation
+    explicit ChatMessage(std::string formatted)
+        : text(std::make_shared<const std::string>(std::move(formatted))) { }
+
+    static ChatMessage format(const std::string& origin, const std::string& message) {
+        return ChatMessage(origin + ": \"" + message + "\"");
+    }
+
+    const std::string& str() const { return text ? *text : empty(); }
+    operator std::string_view() const { return str(); }
+
+    friend bool operator==(const ChatMessage& m, std::string_view s) { return m.str() == s; }
+    friend std::ostream& operator<<(std::ostream& os, const ChatMessage& m) { return os << m.str(); }
+};
+
+// Append-only file of spilled history records, shared by many histories.
+// Record: [u32 length][i64 time][u64 previous record of the same history][bytes]
+// The back link lets a history find its old records while keeping only a
+// sparse index in memory.
+class HistorySegment {
+    static constexpr size_t header_size = 4 + 8 + 8;
+    static constexpr size_t buffer_limit = 64 * 1024;
+
+    int fd = -1;
+    uint64_t flushed = 0;  // bytes already in the file
+    std::string buffer;    // appended but not yet written
+
+public:
+    // Writes buffered records; throws std::system_error if that fails. The
+    // destructor flushes too but can only swallow the error, so call this
+    // to see it.
+    void flush() {
+        for (size_t off = 0; off < buffer.size();) {
+            ssize_t n = ::pwrite(fd, buffer.data() + off, buffer.size() - off, static_cast<off_t>(flushed + off));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                throw std::system_error(errno, std::generic_category(), "history segment write");
+            }
+            off += static_cast<size_t>(n);
+        }
+        flushed += buffer.size();
+        buffer.clear();
+    }
+
+private:
+    void read_at(uint64_t offset, char* out, size_t size) {
+        if (offset + size > flushed) flush();
+        for (size_t off = 0; off < size;) {
+            ssize_t n = ::pread(fd, out + off, size - off, static_cast<off_t>(offset + off));
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) throw std::system_error(n < 0 ? errno : EIO, std::generic_category(), "history segment read");
+            off += static_cast<size_t>(n);
+        }
+    }
+
+public:
+    struct Record {
+        int64_t time;
+        uint64_t previous;
+        std::string text;
+    };
+
+    explicit HistorySegment(const std::string& path) {
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw std::system_error(errno, std::generic_category(), "open " + path);
+        buffer.reserve(buffer_limit);
+    }
+
+    HistorySegment(const HistorySegment&) = delete;
+    HistorySegment& operator=(const HistorySegment&) = delete;
+
+    ~HistorySegment() {
+        try {
+            flush();
+        } catch (const std::exception&) {
+        }
+        ::close(fd);
+    }
+
+    uint64_t append(std::string_view text, int64_t time, uint64_t previous) {
+        uint64_t offset = flushed + buffer.size();
+        char header[header_size];
+        uint32_t len = static_cast<uint32_t>(text.size());
+        std::memcpy(header, &len, 4);
+        std::memcpy(header + 4, &time, 8);
+        std::memcpy(header + 12, &previous, 8);
+        buffer.append(header, header_size).append(text);
+        if (buffer.size() >= buffer_limit) flush();
+        return offset;
+    }
+
+    Record read(uint64_t offset) {
+        char header[header_size];
+        read_at(offset, header, header_size);
+        uint32_t len;
+        Record r;
+        std::memcpy(&len, header, 4);
+        std::memcpy(&r.time, header + 4, 8);
+        std::memcpy(&r.previous, header + 12, 8);
+        r.text.resize(len);
+        read_at(offset + header_size, r.text.data(), len);
+        return r;
+    }
+};
+
+// Bounded per-member message history. The most recent `capacity` messages
+// stay in memory as a ring of shared ChatMessage handles (so a broadcast is
+// still stored once, not once per member); older ones spill to a
+// HistorySegment if one is attached and are dropped otherwise. Indices are
+// absolute: 0 is the first message ever received.
+class MessageHistory {
+public:
+    using clock = std::chrono::system_clock;
+    static constexpr size_t default_capacity = 1024;
+
+    explicit MessageHistory(size_t capacity = default_capacity, HistorySegment* segment = nullptr)
+        : capacity(capacity ? capacity : 1), segment(segment) { }
+
+    // Keeps the newest `recent` messages in memory; older ones spill to the
+    // current segment, or are dropped without one. Switching to another
+    // segment gives up the messages spilled to the previous one.
+    void set_capacity(size_t recent, HistorySegment* spill_to = nullptr) {
+        capacity = recent ? recent : 1;
+        std::rotate(ring.begin(), ring.begin() + static_cast<std::ptrdiff_t>(head), ring.end());
+        head = 0;
+        if (ring.size() > capacity) {
+            auto evicted = ring.begin() + static_cast<std::ptrdiff_t>(ring.size() - capacity);
+            if (segment) std::for_each(ring.begin(), evicted, [this](const Entry& e) { spill(e); });
+            ring.erase(ring.begin(), evicted);
+        }
+        if (spill_to != segment) {
+            segment = spill_to;
+            reset_spill(total - ring.size());
+        }
+    }
+
+    void push_back(const ChatMessage& message, clock::time_point time = clock::now()) {
+        int64_t t = time.time_since_epoch().count();
+        if (ring.size() < capacity) {
+            ring.push_back({message, t}); // grows up to capacity, then never again
+        } else {
+            Entry& oldest = ring[head];
+            if (segment) spill(oldest);
+            oldest = {message, t};
+            head = (head + 1) % capacity;
+        }
+        ++total;
+    }
+
+    // One append for a burst: a single timestamp for all of it.
+    void append(const std::vector<ChatMessage>& burst, clock::time_point time = clock::now()) {
+        for (const auto& message : burst) push_back(message, time);
+    }
+
+    size_t size() const { return total; }
+    // First index still retrievable (in memory or on disk).
+    size_t first() const { return segment ? spill_base : total - ring.size(); }
+    bool empty() const { return total == 0; }
+
+    ChatMessage operator[](size_t i) const {
+        size_t oldest_recent = total - ring.size();
+        if (i >= total) throw std::out_of_range("MessageHistory index");
+        if (i >= oldest_recent) return recent(i - oldest_recent).message;
+        if (i < first()) throw std::out_of_range("MessageHistory message was dropped");
+        return ChatMessage(spilled(i).text);
+    }
+
+    // Up to `count` messages starting at index `from`.
+    std::vector<ChatMessage> page(size_t from, size_t count) const {
+        std::vector<ChatMessage> result;
+        for (size_t i = std::max(from, first()); i < total && result.size() < count; ++i) {
+            result.push_back((*this)[i]);
+        }
+        return result;
+    }
+
+    // Index of the first retrievable message received at or after `time`.
+    size_t index_at(clock::time_point time) const {
+        int64_t t = time.time_since_epoch().count();
+        size_t lo = first(), hi = total;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (time_of(mid) < t) lo = mid + 1;
+            else hi = mid;
+        }
+        return lo;
+    }
+
+    void clear() {
+        ring.clear();
+        head = total = 0;
+        reset_spill(0);
+    }
+
+private:
+    static constexpr size_t checkpoint_every = 32;
+
+    struct Entry {
+        ChatMessage message;
+        int64_t time;
+    };
+
+    const Entry& recent(size_t k) const { return ring[(head + k) % ring.size()]; }
+
+    void spill(const Entry& e) {
+        last_spilled = segment->append(e.message.str(), e.time, last_spilled);
+        if (++spilled_count % checkpoint_every == 0) checkpoints.push_back(last_spilled);
+    }
+
+    void reset_spill(size_t base) {
+        spill_base = base;
+        spilled_count = 0;
+        last_spilled = 0;
+        checkpoints.clear();
+    }
+
+    // Spilled record i, reached by walking back links from the nearest
+    // checkpoint at or after it (at most checkpoint_every - 1 hops).
+    HistorySegment::Record spilled(size_t i) const {
+        i -= spill_base;
+        size_t k = i / checkpoint_every;
+        size_t number = k < checkpoints.size() ? (k + 1) * checkpoint_every - 1 : spilled_count - 1;
+        uint64_t offset = k < checkpoints.size() ? checkpoints[k] : last_spilled;
+        auto record = segment->read(offset);
+        for (; number > i; --number) record = segment->read(record.previous);
+        return record;
+    }
+
+    int64_t time_of(size_t i) const {
+        size_t oldest_recent = total - ring.size();
+        return i >= oldest_recent ? recent(i - oldest_recent).time : spilled(i).time;
+    }
+
+    std::vector<Entry> ring;
+    size_t head = 0;           // oldest entry once the ring is full
+    size_t total = 0;          // messages ever received
+    size_t capacity;
+    HistorySegment* segment;   // not owned
+    size_t spill_base = 0;     // index of the first message spilled to segment
+    size_t spilled_count = 0;
+    uint64_t last_spilled = 0;
+    std::vector<uint64_t> checkpoints; // offset of every checkpoint_every-th spilled record
+};
+
+// Member ids: each room interns the names of the members that join it and
+// works on the 32-bit id from then on. Only member names are interned, so
+// the table is bounded by the room's distinct members; names are looked up
+// again only where they are typed (pm by name) or shown in message headers.
+using MemberId = uint32_t;
+
+// Not synchronized: owned by one Chatroom and used on its thread. Each name's
+// entry also carries where its member sits in the room, so a pm by name is a
+// single map probe followed by the member itself.
+class NameTable {
+public:
+    static constexpr uint32_t no_slot = std::numeric_limits<uint32_t>::max();
+    struct Entry {
+        MemberId id;
+        uint32_t slot = no_slot; // position in Chatroom::people, no_slot if not here
+        uint32_t holders = 0;    // members currently joined under this name
+    };
+
+private:
+    struct NameHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+    using Map = std::unordered_map<std::string, Entry, NameHash, std::equal_to<>>;
+    Map entries;
+    std::vector<Map::value_type*> by_id; // map nodes never move
+
+public:
+    NameTable() = default;
+    NameTable(const NameTable&) = delete;
+    NameTable& operator=(const NameTable&) = delete;
+
+    Entry& intern(std::string_view name) {
+        if (auto it = entries.find(name); it != entries.end()) return it->second;
+        if (by_id.size() == std::numeric_limits<MemberId>::max()) throw std::length_error("NameTable full");
+        auto id = static_cast<MemberId>(by_id.size());
+        by_id.push_back(&*entries.emplace(name, Entry{id}).first);
+        return by_id.back()->second;
+    }
+
+    // Does not intern: typed names that nobody has used stay out of the table.
+    const Entry* find(std::string_view name) const {
+        auto it = entries.find(name);
+        return it == entries.end() ? nullptr : &it->second;
+    }
+
+    std::optional<MemberId> lookup(std::string_view name) const {
+        auto entry = find(name);
+        return entry ? std::optional<MemberId>(entry->id) : std::nullopt;
+    }
+
+    // `id` must have come from intern().
+    Entry& entry(MemberId id) { return by_id[id]->second; }
+    const Entry& entry(MemberId id) const { return by_id[id]->second; }
+
+    // Throws std::out_of_range for an id this table never issued, e.g. one
+    // from another room's table.
+    const std::string& name(MemberId id) const {
+        if (!contains(id)) throw std::out_of_range("unknown member id " + std::to_string(id));
+        return by_id[id]->first;
+    }
+
+    bool contains(MemberId id) const { return id < by_id.size(); }
+    size_t size() const { return by_id.size(); }
+};
+
+// Told about every message a member receives; this is where chat sessions
+// are presented. Chatroom calls it on the delivering thread.
+struct DeliveryObserver {
+    virtual ~DeliveryObserver() = default;
+    virtual void delivered(const std::string& to, const ChatMessage& message) = 0;
+};
+
+// Writes each delivery to std::cout immediately (the default).
+struct ConsoleObserver : DeliveryObserver {
+    static ConsoleObserver& instance() {
+        static ConsoleObserver console;
+        return console;
+    }
+    void delivered(const std::string& to, const ChatMessage& message) override {
+        std::cout << "[" << to << "'s chat session] " << message << "\n";
+    }
+};
+
+struct NoopObserver : DeliveryObserver {
+    void delivered(const std::string&, const ChatMessage&) override { }
+};
+
+// Formats deliveries into a buffer and writes it to the stream in one call
+// once `limit` bytes have accumulated, on flush() and on destruction.
+class BufferedConsoleObserver : public DeliveryObserver {
+    std::ostream& os;
+    std::string buffer;
+    size_t limit;
+
+public:
+    explicit BufferedConsoleObserver(std::ostream& os = std::cout, size_t limit = 64 * 1024)
+        : os(os), limit(limit) { buffer.reserve(limit + 256); }
+    ~BufferedConsoleObserver() override { flush(); }
+
+    void delivered(const std::string& to, const ChatMessage& message) override {
+        buffer.append("[").append(to).append("'s chat session] ")
+              .append(message.str()).append("\n");
+        if (buffer.size() >= limit) flush();
+    }
+
+    void flush() {
+        os.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        buffer.clear();
+    }
+};
+
+// Records the console transcript in memory for tests.
+struct CaptureObserver : DeliveryObserver {
+    std::string output;
+    void delivered(const std::string& to, const ChatMessage& message) override {
+        output.append("[").append(to).append("'s chat session] ")
+              .append(message.str()).append("\n");
+    }
+};
+
 struct Chatroom {
-    std::vector<Person*> people;
-    void join(Person* person);
+    DeliveryObserver* observer = &ConsoleObserver::instance(); // not owned
+    Chatroom() = default;
+    Chatroom(const Chatroom&) = delete;
+    Chatroom& operator=(const Chatroom&) = delete;
+    // Read-only: membership changes go through join/leave so the index stays
+    // consistent. Chatroom is neither copyable nor movable, so the view
+    // can't outlive or point at another room's members.
+    const std::vector<Person*>& people = member_slots;
+    const std::vector<Person*>& members() const { return member_slots; }
+    size_t size() const { return member_slots.size(); }
+    void reserve(size_t members) { member_slots.reserve(members); }
+    // Assigns person->id in this room.
+    void join(Person* person, bool announce = true);
+    Person* find(MemberId id) const;
+    Person* find(std::string_view name) const;
+    void broadcast(MemberId origin, const std::string& message);
     void broadcast(const std::string& origin, const std::string& message);
+    void message(MemberId origin, MemberId who, const std::string& message);
     void message(const std::string& origin, const std::string& who, const std::string& message);
     void leave(Person* person);
+
+    // Topics: sub-channels inside the room. Subscriptions are bitsets over
+    // member slots (positions in people), so fanning out to a topic walks
+    // set bits instead of testing every member.
+    void subscribe(Person* person, const std::string& topic);
+    void unsubscribe(Person* person, const std::string& topic);
+    void publish(MemberId origin, const std::string& topic, const std::string& message);
+    void publish(const std::string& origin, const std::string& topic, const std::string& message);
+    // Formats the burst once and hands each subscriber all of it in one append.
+    void publish(MemberId origin, const std::string& topic, const std::vector<std::string>& burst);
+    void publish(const std::string& origin, const std::string& topic, const std::vector<std::string>& burst);
+
+private:
+    std::vector<Person*> member_slots;
+    // Members with the same name share an id and entry; the entry's slot
+    // points at one of them, and another holder takes over when it leaves.
+    NameTable names;
+    size_t slot_of(const Person* person) const;
+    // Delivers to everyone but `skip` (no_member to skip nobody).
+    void broadcast(const ChatMessage& formatted, MemberId skip);
+    template <typename F>
+    void for_each_subscriber(const std::string& topic, F&& f) const;
+
+    std::unordered_map<std::string, std::vector<uint64_t>> topics;
+
+public:
+    static constexpr MemberId no_member = std::numeric_limits<MemberId>::max();
 };
 
 struct Person {
     std::string name;
+    MemberId id = Chatroom::no_member; // set on join, valid in that room
     Chatroom* room = nullptr;
-    std::vector<std::string> messages;
+    MessageHistory messages;
     Person(const std::string& name) : name(name) { }
     void receive(const std::string& origin, const std::string& message);
+    void receive(const ChatMessage& message);
+    void receive(const std::vector<ChatMessage>& burst);
     void say(const std::string& message) const;
+    void pm(MemberId who, const std::string& message) const;
     void pm(const std::string& who, const std::string& message) const;
 };
 
-void Chatroom::join(Person* person) {
-    people.push_back(person);
+void Chatroom::join(Person* person, bool announce) {
+    auto& entry = names.intern(person->name);
+    person->id = entry.id;
+    if (entry.holders++ == 0) entry.slot = static_cast<uint32_t>(member_slots.size());
+    member_slots.push_back(person);
     person->room = this;
-    broadcast("room", person->name + " has joined the chat");
+    if (announce) broadcast("room", person->name + " has joined the chat");
 }
 
+void Chatroom::broadcast(const ChatMessage& formatted, MemberId skip) {
+    for (auto person : member_slots) {
+        if (person->id != skip) person->receive(formatted);
+    }
+}
+
+void Chatroom::broadcast(MemberId origin, const std::string& message) {
+    broadcast(ChatMessage::format(names.name(origin), message), origin);
+}
+
+// origin need not be a member ("room" announcements); it is not interned.
 void Chatroom::broadcast(const std::string& origin, const std::string& message) {
-    for (auto person : people) {
-        if (person->name != origin) person->receive(origin, message);
+    broadcast(ChatMessage::format(origin, message), names.lookup(origin).value_or(no_member));
+}
+
+Person* Chatroom::find(MemberId id) const {
+    if (id >= names.size()) return nullptr;
+    uint32_t slot = names.entry(id).slot;
+    return slot != NameTable::no_slot ? member_slots[slot] : nullptr;
+}
+
+Person* Chatroom::find(std::string_view name) const {
+    auto entry = names.find(name);
+    return entry && entry->slot != NameTable::no_slot ? member_slots[entry->slot] : nullptr;
+}
+
+void Chatroom::message(MemberId origin, MemberId who, const std::string& message) {
+    if (auto targetPerson = find(who)) {
+        targetPerson->receive(ChatMessage::format(names.name(origin), message));
+    } else if (auto originPerson = find(origin)) {
+        // an id this room never issued has no name to show
+        std::string target = names.contains(who) ? names.name(who) : "#" + std::to_string(who);
+        originPerson->receive(names.name(origin), "User " + target + " not found");
     }
 }
 
 void Chatroom::message(const std::string& origin, const std::string& who,
                        const std::string& message) {
-    auto targetPerson = std::find_if(std::begin(people), std::end(people),
-                               [&](const Person* person) { return person->name == who; });
-    if (targetPerson != std::end(people)) {
-        (*targetPerson)->receive(origin, message);
-    } else {
-        auto originPerson = std::find_if(std::begin(people), std::end(people),
-                                          [&](const Person* person) { return person->name == origin; });
-        if (originPerson != std::end(people)) {
-            (*originPerson)->receive(origin, "User " + who + " not found");
-        }
+    if (auto targetPerson = find(who)) {
+        targetPerson->receive(ChatMessage::format(origin, message));
+    } else if (auto originPerson = find(origin)) {
+        originPerson->receive(origin, "User " + who + " not found");
     }
 }
 
 void Person::say(const std::string& message) const {
-    if (room) room->broadcast(name, message);
+    if (room) room->broadcast(id, message);
+}
+
+void Person::pm(MemberId who, const std::string& message) const {
+    if (room) room->message(id, who, message);
 }
 
 void Person::pm(const std::string& who, const std::string& message) const {
-    if (room) {
-        room->message(name, who, message);
-    }
+    if (room) room->message(name, who, message);
 }
 
 void Person::receive(const std::string& origin, const std::string& message) {
-    std::string s{origin + ": \"" + message + "\""};
-    messages.emplace_back(s);
-    std::cout << "[" << name << "'s chat session] " << s << "\n";
+    receive(ChatMessage::format(origin, message));
+}
+
+void Person::receive(const ChatMessage& message) {
+    messages.push_back(message);
+    (room ? room->observer : &ConsoleObserver::instance())->delivered(name, message);
+}
+
+void Person::receive(const std::vector<ChatMessage>& burst) {
+    messages.append(burst);
+    auto* observer = room ? room->observer : &ConsoleObserver::instance();
+    for (const auto& message : burst) observer->delivered(name, message);
+}
+
+// Swap-and-pop: the last member takes the leaver's slot, so the order of
+// people is not preserved across leaves.
+size_t Chatroom::slot_of(const Person* person) const {
+    if (person->id < names.size()) {
+        uint32_t slot = names.entry(person->id).slot;
+        if (slot != NameTable::no_slot && member_slots[slot] == person) return slot;
+    }
+    return static_cast<size_t>(std::find(member_slots.begin(), member_slots.end(), person) - member_slots.begin());
 }
 
 void Chatroom::leave(Person* person) {
-    auto it = std::remove(people.begin(), people.end(), person);
-    if (it != people.end()) {
-        people.erase(it, people.end());
-        broadcast("room", person->name + " has left the chat");
-        person->room = nullptr;
+    size_t pos = slot_of(person);
+    if (pos == member_slots.size()) return;
+
+    size_t last = member_slots.size() - 1;
+    for (auto& [topic, bits] : topics) {
+        // the last slot's subscriptions follow it into pos; the last slot
+        // itself is always emptied, even when the leaver holds it
+        uint64_t moved_bit = pos != last && last / 64 < bits.size() ? (bits[last / 64] >> (last % 64)) & 1 : 0;
+        if (last / 64 < bits.size()) bits[last / 64] &= ~(uint64_t{1} << (last % 64));
+        if (pos / 64 < bits.size()) {
+            bits[pos / 64] = (bits[pos / 64] & ~(uint64_t{1} << (pos % 64))) | (moved_bit << (pos % 64));
+        }
+    }
+    if (pos != last) {
+        member_slots[pos] = member_slots.back();
+        uint32_t& moved = names.entry(member_slots[pos]->id).slot;
+        if (moved == last) moved = static_cast<uint32_t>(pos);
     }
+    member_slots.pop_back();
+    auto& entry = names.entry(person->id);
+    if (--entry.holders == 0) {
+        entry.slot = NameTable::no_slot;
+    } else if (entry.slot == pos && (pos == member_slots.size() || member_slots[pos]->id != person->id)) {
+        // the leaver was the indexed holder of a shared name: re-point at another
+        auto other = std::find_if(member_slots.begin(), member_slots.end(), [&](const Person* p) { return p->id == person->id; });
+        entry.slot = static_cast<uint32_t>(other - member_slots.begin());
+    }
+    broadcast("room", person->name + " has left the chat");
+    person->room = nullptr;
+}
+
+void Chatroom::subscribe(Person* person, const std::string& topic) {
+    size_t pos = slot_of(person);
+    if (pos == member_slots.size()) return;
+    auto& bits = topics[topic];
+    if (bits.size() <= pos / 64) bits.resize(pos / 64 + 1, 0);
+    bits[pos / 64] |= uint64_t{1} << (pos % 64);
+}
+
+void Chatroom::unsubscribe(Person* person, const std::string& topic) {
+    size_t pos = slot_of(person);
+    auto it = topics.find(topic);
+    if (pos == member_slots.size() || it == topics.end() || it->second.size() <= pos / 64) return;
+    it->second[pos / 64] &= ~(uint64_t{1} << (pos % 64));
+}
+
+template <typename F>
+void Chatroom::for_each_subscriber(const std::string& topic, F&& f) const {
+    auto it = topics.find(topic);
+    if (it == topics.end()) return;
+    const auto& bits = it->second;
+    for (size_t w = 0; w < bits.size(); ++w) {
+        for (uint64_t word = bits[w]; word; word &= word - 1) {
+            f(member_slots[w * 64 + static_cast<size_t>(std::countr_zero(word))]);
+        }
+    }
+}
+
+void Chatroom::publish(MemberId origin, const std::string& topic, const std::string& message) {
+    ChatMessage formatted = ChatMessage::format(names.name(origin) + " #" + topic, message);
+    for_each_subscriber(topic, [&](Person* person) {
+        if (person->id != origin) person->receive(formatted);
+    });
+}
+
+void Chatroom::publish(const std::string& origin, const std::string& topic, const std::string& message) {
+    ChatMessage formatted = ChatMessage::format(origin + " #" + topic, message);
+    MemberId skip = names.lookup(origin).value_or(no_member);
+    for_each_subscriber(topic, [&](Person* person) {
+        if (person->id != skip) person->receive(formatted);
+    });
+}
+
+void Chatroom::publish(MemberId origin, const std::string& topic, const std::vector<std::string>& burst) {
+    publish(names.name(origin), topic, burst);
+}
+
+void Chatroom::publish(const std::string& origin, const std::string& topic,
+                       const std::vector<std::string>& burst) {
+    const std::string header = origin + " #" + topic;
+    std::vector<ChatMessage> formatted;
+    formatted.reserve(burst.size());
+    for (const auto& message : burst) formatted.push_back(ChatMessage::format(header, message));
+    MemberId skip = names.lookup(origin).value_or(no_member);
+    for_each_subscriber(topic, [&](Person* person) {
+        if (person->id != skip) person->receive(formatted);
+    });
+}
+
+// Lock-free multi-producer / single-consumer queue (Vyukov). push() may be
+// called from any thread, pop() only from the owning consumer.
+template <typename T>
+class MpscQueue {
+    struct Node {
+        std::atomic<Node*> next{ nullptr };
+        std::optional<T> value;
+    };
+
+    std::atomic<Node*> head; // producers link new nodes here
+    Node* tail;              // consumer side; always a consumed stub
+
+public:
+    MpscQueue() : head(new Node), tail(head.load()) { }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    ~MpscQueue() {
+        while (Node* next = tail->next.load(std::memory_order_relaxed)) {
+            delete tail;
+            tail = next;
+        }
+        delete tail;
+    }
+
+    void push(T value) {
+        Node* node = new Node;
+        node->value.emplace(std::move(value));
+        Node* prev = head.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // False when empty, or while a producer is between its two steps.
+    bool pop(T& out) {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) return false;
+        out = std::move(*next->value);
+        next->value.reset();
+        delete tail;
+        tail = next;
+        return true;
+    }
+};
+
+// Bounded lock-free queue (Vyukov's MPMC ring). Any thread may push or pop;
+// try_push() fails instead of blocking when the ring is full. Capacity is
+// rounded up to a power of two.
+template <typename T>
+class BoundedQueue {
+    struct Cell {
+        std::atomic<size_t> seq;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> enqueue_pos{ 0 };
+    alignas(64) std::atomic<size_t> dequeue_pos{ 0 };
+
+public:
+    BoundedQueue() = default;
+    explicit BoundedQueue(size_t capacity) { reset(capacity); }
+
+    // Not thread-safe; call before the queue is shared.
+    void reset(size_t capacity) {
+        size_t size = std::bit_ceil(std::max<size_t>(capacity, 2));
+        cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) cells[i].seq.store(i, std::memory_order_relaxed);
+        mask = size - 1;
+        enqueue_pos.store(0);
+        dequeue_pos.store(0);
+    }
+
+    size_t capacity() const { return mask + 1; }
+
+    bool try_push(const T& value) {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            auto dif = static_cast<std::ptrdiff_t>(seq - pos);
+            if (dif == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false; // full
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(T& out) {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells[pos & mask];
+            size_t seq = cell.seq.load(std::memory_order_acquire);
+            auto dif = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+            if (dif == 0) {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    out = std::move(cell.value);
+                    cell.value = T{}; // release the payload now, not when the slot is reused
+                    cell.seq.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false; // empty
+            } else {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+// Token bucket in GCRA form: one atomic "theoretical arrival time". Each
+// accepted message pushes it `interval` into the future; a message is
+// refused while that would put it more than `burst` messages ahead.
+class RateLimiter {
+    std::atomic<int64_t> tat{ 0 };
+
+public:
+    bool allow(int64_t now_ns, int64_t interval_ns, int64_t burst) {
+        int64_t tolerance = (burst - 1) * interval_ns;
+        int64_t t = tat.load(std::memory_order_relaxed);
+        for (;;) {
+            int64_t start = std::max(t, now_ns);
+            if (start - now_ns > tolerance) return false;
+            if (tat.compare_exchange_weak(t, start + interval_ns, std::memory_order_relaxed)) return true;
+        }
+    }
+};
+
+// What happens to a delivery for a member whose inbox is full.
+enum class InboxFull { drop_oldest, drop_new, disconnect };
+
+struct ChatServerOptions {
+    size_t inbox_capacity = 256;
+    InboxFull when_full = InboxFull::drop_oldest;
+    double send_rate = 0;   // messages/sec per sender; 0 means unlimited
+    int64_t send_burst = 1; // messages a sender may send back to back
+};
+
+// Multi-threaded chat core. Rooms are partitioned across shard threads by
+// room id and users by user id; each shard owns its rooms' member lists
+// and only ever touches them on its own thread. Every user has a lock-free
+// inbox that any shard may deliver into. Private messages go to the
+// sender's shard, which hands them to the recipient's shard as a message.
+// Inboxes are bounded so a slow consumer only ever loses its own messages;
+// senders can be rate limited.
+class ShardedChatServer {
+public:
+    using UserId = uint32_t;
+    using RoomId = uint32_t;
+    using clock = std::chrono::steady_clock;
+
+    struct Delivery {
+        ChatMessage message;
+        clock::time_point sent;
+    };
+
+    struct MemberStats {
+        uint64_t dropped, rate_limited;
+        bool disconnected;
+    };
+
+    // Throws std::invalid_argument for zero shards.
+    ShardedChatServer(size_t shard_count, size_t max_users, const ChatServerOptions& options = {})
+        : options(options), users(new User[max_users]), max_users(max_users), shards(shard_count) {
+        if (shard_count == 0) throw std::invalid_argument("ShardedChatServer needs at least one shard");
+        for (size_t u = 0; u < max_users; ++u) users[u].inbox.reset(options.inbox_capacity);
+        for (size_t i = 0; i < shards.size(); ++i) {
+            shards[i].thread = std::thread(&ShardedChatServer::run, this, i);
+        }
+    }
+
+    ShardedChatServer(const ShardedChatServer&) = delete;
+    ShardedChatServer& operator=(const ShardedChatServer&) = delete;
+
+    ~ShardedChatServer() {
+        flush();
+        stopping.store(true);
+        for (auto& shard : shards) {
+            shard.signal.fetch_add(1, std::memory_order_release);
+            shard.signal.notify_one();
+            shard.thread.join();
+        }
+    }
+
+    // Not synchronized with traffic; connect users before they send.
+    UserId connect(const std::string& name) {
+        UserId id = user_count.load(std::memory_order_relaxed);
+        if (id >= max_users) throw std::length_error("ShardedChatServer is full");
+        users[id].name = name;
+        user_count.store(id + 1, std::memory_order_release);
+        return id;
+    }
+
+    // Every call taking a user throws std::out_of_range for an id that
+    // connect() has not handed out. A pm to an unknown recipient is dropped.
+    void join(UserId user, RoomId room) {
+        check(user);
+        post(room_shard(room), {Command::join, user, 0, room, {}, {}, {}});
+    }
+    void leave(UserId user, RoomId room) {
+        check(user);
+        post(room_shard(room), {Command::leave, user, 0, room, {}, {}, {}});
+    }
+
+    // Clears a disconnect (InboxFull::disconnect). The user is taken out of
+    // every room it was still listed in and has to join again.
+    void reconnect(UserId user) {
+        check(user);
+        users[user].disconnected.store(false, std::memory_order_relaxed);
+        for (size_t shard = 0; shard < shards.size(); ++shard) {
+            post(shard, {Command::leave_all, user, 0, 0, {}, {}, {}});
+        }
+    }
+
+    // Both return false if the sender is over its rate limit.
+    bool say(UserId from, RoomId room, std::string text) {
+        check(from);
+        auto now = clock::now();
+        if (!admit(from, now)) return false;
+        post(room_shard(room), {Command::say, from, 0, room, std::move(text), now, {}});
+        return true;
+    }
+
+    bool pm(UserId from, UserId to, std::string text) {
+        check(from);
+        auto now = clock::now();
+        if (!admit(from, now)) return false;
+        post(user_shard(from), {Command::pm, from, to, 0, std::move(text), now, {}});
+        return true;
+    }
+
+    // Popped by the user's consumer; shards may also pop to drop the oldest.
+    BoundedQueue<Delivery>& inbox(UserId user) { return users[check(user)].inbox; }
+    const std::string& name(UserId user) const { return users[check(user)].name; }
+
+    MemberStats stats(UserId user) const {
+        const User& u = users[check(user)];
+        return {u.dropped.load(), u.rate_limited.load(), u.disconnected.load()};
+    }
+
+    // Blocks until every command posted so far, and anything it forwarded,
+    // has been delivered.
+    void flush() const {
+        for (uint64_t n; (n = in_flight.load(std::memory_order_acquire)) != 0;) in_flight.wait(n);
+    }
+
+private:
+    struct Command {
+        enum Kind { join, leave, leave_all, say, pm, deliver } kind;
+        UserId from, to;
+        RoomId room;
+        std::string text;
+        clock::time_point sent;
+        std::optional<ChatMessage> message; // set when handed off for delivery
+    };
+
+    struct User {
+        std::string name;
+        BoundedQueue<Delivery> inbox;
+        RateLimiter limiter;
+        std::atomic<uint64_t> dropped{ 0 }, rate_limited{ 0 };
+        std::atomic<bool> disconnected{ false };
+    };
+
+    struct Shard {
+        MpscQueue<Command> commands;
+        std::atomic<uint32_t> signal{ 0 };
+        std::unordered_map<RoomId, std::vector<UserId>> rooms; // owned by this shard's thread
+        std::thread thread;
+    };
+
+    UserId check(UserId user) const {
+        if (user >= user_count.load(std::memory_order_acquire)) {
+            throw std::out_of_range("unknown user id " + std::to_string(user));
+        }
+        return user;
+    }
+
+    size_t room_shard(RoomId room) const { return room % shards.size(); }
+    size_t user_shard(UserId user) const { return user % shards.size(); }
+
+    bool admit(UserId from, clock::time_point now) {
+        if (options.send_rate <= 0) return true;
+        auto interval = static_cast<int64_t>(1e9 / options.send_rate);
+        auto now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+        if (users[from].limiter.allow(now_ns, interval, std::max<int64_t>(options.send_burst, 1))) return true;
+        users[from].rate_limited.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Applies the overflow policy; never blocks the delivering shard.
+    void deliver(UserId to, const Delivery& d) {
+        User& u = users[to];
+        if (u.disconnected.load(std::memory_order_relaxed)) {
+            u.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        while (!u.inbox.try_push(d)) {
+            u.dropped.fetch_add(1, std::memory_order_relaxed);
+            if (options.when_full == InboxFull::drop_new) return;
+            if (options.when_full == InboxFull::disconnect) {
+                u.disconnected.store(true, std::memory_order_relaxed);
+                return;
+            }
+            Delivery oldest;
+            if (!u.inbox.pop(oldest)) u.dropped.fetch_sub(1, std::memory_order_relaxed); // consumer got there first
+        }
+    }
+
+    void post(size_t shard, Command command) {
+        in_flight.fetch_add(1, std::memory_order_relaxed);
+        shards[shard].commands.push(std::move(command));
+        shards[shard].signal.fetch_add(1, std::memory_order_release);
+        shards[shard].signal.notify_one();
+    }
+
+    void run(size_t index) {
+        Shard& shard = shards[index];
+        Command command;
+        for (;;) {
+            uint32_t seen = shard.signal.load(std::memory_order_acquire);
+            if (shard.commands.pop(command)) {
+                process(shard, command);
+                if (in_flight.fetch_sub(1, std::memory_order_acq_rel) == 1) in_flight.notify_all();
+                continue;
+            }
+            if (stopping.load()) return;
+            shard.signal.wait(seen, std::memory_order_acquire);
+        }
+    }
+
+    static void remove_member(std::vector<UserId>& members, UserId user) {
+        auto it = std::find(members.begin(), members.end(), user);
+        if (it != members.end()) {
+            *it = members.back();
+            members.pop_back();
+        }
+    }
+
+    void process(Shard& shard, Command& c) {
+        switch (c.kind) {
+        case Command::join:
+            shard.rooms[c.room].push_back(c.from);
+            break;
+        case Command::leave:
+            remove_member(shard.rooms[c.room], c.from);
+            break;
+        case Command::leave_all:
+            for (auto& [room, members] : shard.rooms) remove_member(members, c.from);
+            break;
+        case Command::say: {
+            auto room = shard.rooms.find(c.room);
+            if (room == shard.rooms.end()) break;
+            Delivery d{ChatMessage::format(users[c.from].name, c.text), c.sent};
+            auto& members = room->second;
+            for (size_t i = 0; i < members.size();) {
+                if (users[members[i]].disconnected.load(std::memory_order_relaxed)) {
+                    members[i] = members.back(); // forget disconnected members lazily
+                    members.pop_back();
+                    continue;
+                }
+                if (members[i] != c.from) deliver(members[i], d);
+                ++i;
+            }
+            break;
+        }
+        case Command::pm:
+            if (c.to >= user_count.load()) break;
+            c.message = ChatMessage::format(users[c.from].name, c.text);
+            if (user_shard(c.to) != user_shard(c.from)) {
+                c.kind = Command::deliver;
+                post(user_shard(c.to), std::move(c)); // cross-shard hand-off
+                break;
+            }
+            [[fallthrough]];
+        case Command::deliver:
+            deliver(c.to, {*c.message, c.sent});
+            break;
+        }
+    }
+
+    ChatServerOptions options;
+    std::unique_ptr<User[]> users;
+    size_t max_users;
+    std::atomic<UserId> user_count{ 0 };
+    std::atomic<uint64_t> in_flight{ 0 };
+    std::atomic<bool> stopping{ false };
+    std::vector<Shard> shards;
+};
+
+// Load generator for ShardedChatServer: `users` users spread over `rooms`
+// rooms, `producers` threads sending `messages` room messages each (every
+// tenth is a pm instead) and `consumers` threads draining the inboxes.
+// Users, rooms and shards must be positive (std::invalid_argument).
+struct ChatLoadOptions {
+    size_t users = 1'000, rooms = 10, shards = 4;
+    size_t producers = 4, consumers = 4, messages = 2'000;
+};
+
+inline int run_chat_load(const ChatLoadOptions& o) {
+    if (o.users == 0 || o.rooms == 0 || o.shards == 0)
+        throw std::invalid_argument("chat load needs at least one user, room and shard");
+    using clock = ShardedChatServer::clock;
+    ShardedChatServer server(o.shards, o.users);
+    for (size_t u = 0; u < o.users; ++u) {
+        auto id = server.connect("user" + std::to_string(u));
+        server.join(id, static_cast<ShardedChatServer::RoomId>(u % o.rooms));
+    }
+    server.flush();
+
+    std::atomic<bool> done{ false };
+    std::vector<std::vector<double>> latencies(o.consumers);
+    std::vector<std::thread> consumers;
+    for (size_t c = 0; c < o.consumers; ++c) {
+        consumers.emplace_back([&, c] {
+            ShardedChatServer::Delivery d;
+            auto drain = [&] {
+                bool any = false;
+                for (size_t u = c; u < o.users; u += o.consumers) {
+                    while (server.inbox(static_cast<ShardedChatServer::UserId>(u)).pop(d)) {
+                        latencies[c].push_back(std::chrono::duration<double, std::micro>(clock::now() - d.sent).count());
+                        any = true;
+                    }
+                }
+                return any;
+            };
+            while (!done.load()) {
+                if (!drain()) std::this_thread::yield();
+            }
+            drain();
+        });
+    }
+
+    auto t0 = clock::now();
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < o.producers; ++p) {
+        producers.emplace_back([&, p] {
+            for (size_t i = 0; i < o.messages; ++i) {
+                auto from = static_cast<ShardedChatServer::UserId>((p + i * o.producers) % o.users);
+                if (i % 10 == 9) {
+                    server.pm(from, static_cast<ShardedChatServer::UserId>((from + 1 + i) % o.users), "psst");
+                } else {
+                    server.say(from, static_cast<ShardedChatServer::RoomId>(from % o.rooms), "hello room");
+                }
+            }
+        });
+    }
+    for (auto& t : producers) t.join();
+    server.flush();
+    done.store(true);
+    for (auto& t : consumers) t.join();
+    double seconds = std::chrono::duration<double>(clock::now() - t0).count();
+
+    std::vector<double> all;
+    for (auto& l : latencies) all.insert(all.end(), l.begin(), l.end());
+    std::sort(all.begin(), all.end());
+    auto pct = [&](double q) { return all.empty() ? 0.0 : all[static_cast<size_t>(q * (all.size() - 1))]; };
+    uint64_t dropped = 0;
+    for (size_t u = 0; u < o.users; ++u) dropped += server.stats(static_cast<ShardedChatServer::UserId>(u)).dropped;
+    std::cout << o.users << " users, " << o.rooms << " rooms, " << o.shards << " shards, "
+              << dropped << " dropped: "
+              << static_cast<long>(o.producers * o.messages / seconds) << " messages/sec, "
+              << static_cast<long>(all.size() / seconds) << " deliveries/sec, latency p50 "
+              << pct(0.50) << " us, p99 " << pct(0.99) << " us, p99.9 " << pct(0.999) << " us\n";
+    return 0;
 }
 
 class ChatroomTest : public ::testing::Test {
@@ -184,7 +1232,850 @@ TEST_F(ChatroomTest, MessageStorage) {
     EXPECT_EQ(jane.messages[1], "John: \"Hello!\"");
 }
 
+TEST_F(ChatroomTest, IndexStaysConsistentAfterLeaves) {
+    Chatroom room;
+    std::vector<std::unique_ptr<Person>> members;
+    for (const char* name : {"A", "B", "C", "D"}) {
+        members.push_back(std::make_unique<Person>(name));
+        room.join(members.back().get());
+    }
+
+    room.leave(members[0].get()); // D moves into A's slot
+    room.leave(members[2].get());
+
+    EXPECT_EQ(room.size(), size_t(2));
+    EXPECT_EQ(room.find("A"), nullptr);
+    EXPECT_EQ(room.find("C"), nullptr);
+    EXPECT_EQ(room.find("B"), members[1].get());
+    EXPECT_EQ(room.find("D"), members[3].get());
+
+    output.str("");
+    members[1]->pm("D", "still here?");
+    EXPECT_EQ(output.str(), "[D's chat session] B: \"still here?\"\n");
+
+    room.join(members[0].get());
+    EXPECT_EQ(room.find("A"), members[0].get());
+}
+
+TEST_F(ChatroomTest, LeavingTwiceIsNoop) {
+    Chatroom room;
+    Person john("John");
+    Person jane("Jane");
+    room.join(&john);
+    room.join(&jane);
+    room.leave(&john);
+
+    output.str("");
+    room.leave(&john);
+
+    EXPECT_EQ(room.size(), size_t(1));
+    EXPECT_EQ(output.str(), "");
+}
+
+TEST_F(ChatroomTest, SameNameMembersStayReachable) {
+    Chatroom room;
+    CaptureObserver capture;
+    room.observer = &capture;
+    Person bob("Bob");
+    Person first("Sam");
+    Person second("Sam");
+    Person carol("Carol");
+    room.join(&bob);
+    room.join(&first);  // indexed holder of "Sam"
+    room.join(&second);
+    room.join(&carol);
+
+    room.leave(&first); // Carol moves into the indexed slot
+    EXPECT_EQ(room.find("Sam"), &second);
+    capture.output.clear();
+    bob.pm("Sam", "still there?");
+    EXPECT_EQ(capture.output, "[Sam's chat session] Bob: \"still there?\"\n");
+
+    Person third("Sam");
+    room.join(&third);
+    room.leave(&bob);   // third moves to slot 0; second, the indexed one, is now last
+    room.leave(&second);
+    EXPECT_EQ(room.find("Sam"), &third);
+    room.leave(&third);
+    EXPECT_EQ(room.find("Sam"), nullptr);
+    EXPECT_EQ(room.size(), size_t(1));
+}
+
+TEST(NameTableTest, InternsOncePerName) {
+    NameTable names;
+    MemberId john = names.intern("John").id;
+    EXPECT_EQ(names.intern(std::string("John")).id, john);
+    EXPECT_NE(names.intern("Jane").id, john);
+    EXPECT_EQ(names.name(john), "John");
+    EXPECT_EQ(names.lookup("Jane"), names.intern("Jane").id);
+    EXPECT_FALSE(names.lookup("Bob"));
+    EXPECT_EQ(names.size(), size_t(2));
+}
+
+TEST(NameTableTest, NamesStayPutAsTableGrows) {
+    NameTable names;
+    const std::string& first = names.name(names.intern("user0").id);
+    for (size_t i = 1; i < 5'000; ++i) {
+        std::string name = "user";
+        names.intern(name += std::to_string(i));
+    }
+    EXPECT_EQ(&names.name(0), &first);
+    EXPECT_EQ(names.name(4'999), "user4999");
+    EXPECT_EQ(names.lookup("user3072"), MemberId(3'072));
+}
+
+TEST_F(ChatroomTest, IdsAddressMembers) {
+    Chatroom room;
+    Person john("John");
+    Person jane("Jane");
+    room.join(&john);
+    room.join(&jane);
+    EXPECT_EQ(room.find(jane.id), &jane);
+    EXPECT_EQ(room.find("Jane"), &jane);
+
+    output.str("");
+    john.pm(jane.id, "hi");
+    room.broadcast(john.id, "all");
+    EXPECT_EQ(output.str(), "[Jane's chat session] John: \"hi\"\n"
+                            "[Jane's chat session] John: \"all\"\n");
+
+    room.leave(&jane);
+    EXPECT_EQ(room.find(jane.id), nullptr);
+    output.str("");
+    john.pm(jane.id, "still there?");
+    EXPECT_EQ(output.str(), "[John's chat session] John: \"User Jane not found\"\n");
+}
+
+TEST_F(ChatroomTest, UnknownIdsAreNotFound) {
+    Chatroom room, other;
+    Person john("John");
+    room.join(&john);
+    Person a("A"), b("B"), c("C");
+    other.join(&a);
+    other.join(&b);
+    other.join(&c);
+
+    output.str("");
+    john.pm(Chatroom::no_member, "anyone?");
+    john.pm(c.id, "from the other room"); // ids are per room: 2 is unknown here
+    EXPECT_EQ(output.str(), "[John's chat session] John: \"User #4294967295 not found\"\n"
+                            "[John's chat session] John: \"User #2 not found\"\n");
+    EXPECT_THROW(room.broadcast(c.id, "hi"), std::out_of_range);
+    EXPECT_THROW(room.publish(c.id, "t", "hi"), std::out_of_range);
+}
+
+// Benchmarks are disabled by default, run them with:
+//   ./chatroom --gtest_also_run_disabled_tests --gtest_filter='ChatroomBenchmark.*'
+static std::string numbered(std::string prefix, size_t n) {
+    return prefix += std::to_string(n);
+}
+
+// Room of `size` members, each with a unique name.
+static std::vector<std::unique_ptr<Person>> populate(Chatroom& room, size_t size) {
+    std::vector<std::unique_ptr<Person>> members;
+    members.reserve(size);
+    room.reserve(size);
+    for (size_t i = 0; i < size; ++i) {
+        members.push_back(std::make_unique<Person>(numbered("user", i)));
+        room.join(members.back().get(), false); // announcing is O(n) per join
+    }
+    return members;
+}
+
+TEST(ChatroomBenchmark, DISABLED_PrivateMessageLatency) {
+    for (size_t size : {10, 1'000, 100'000}) {
+        Chatroom room;
+        auto members = populate(room, size);
+        std::ostringstream sink;
+        auto* old = std::cout.rdbuf(sink.rdbuf());
+
+        constexpr size_t pms = 100'000;
+        auto t0 = bench_clock::now();
+        for (size_t i = 0; i < pms; ++i) {
+            members[i % size]->pm(members[(i * 7919) % size]->name, "hi");
+            if (i % 1024 == 0) {
+                sink.str("");
+                members[(i * 7919) % size]->messages.clear();
+            }
+        }
+        double ns = elapsed_ns(t0) / pms;
+
+        t0 = bench_clock::now();
+        for (size_t i = 0; i < pms; ++i) {
+            members[i % size]->pm(members[(i * 7919) % size]->id, "hi");
+            if (i % 1024 == 0) {
+                sink.str("");
+                members[(i * 7919) % size]->messages.clear();
+            }
+        }
+        double id_ns = elapsed_ns(t0) / pms;
+
+        // the previous lookup: a linear scan comparing names
+        size_t found = 0;
+        constexpr size_t scans = 1'000;
+        t0 = bench_clock::now();
+        for (size_t i = 0; i < scans; ++i) {
+            const std::string& who = members[(i * 7919) % size]->name;
+            found += std::find_if(room.members().begin(), room.members().end(),
+                                  [&](const Person* p) { return p->name == who; }) != room.members().end();
+        }
+        double scan_ns = elapsed_ns(t0) / scans;
+        std::cout.rdbuf(old);
+        EXPECT_EQ(found, scans);
+        std::cout << size << " members: pm by name " << ns << " ns, by id " << id_ns
+                  << " ns, linear name scan alone " << scan_ns << " ns\n";
+    }
+}
+
+// 10k members, 1k broadcasts. Run the two cases in separate processes
+// (--gtest_filter) so RSS deltas don't include freed heap.
+TEST(ChatroomBenchmark, DISABLED_BroadcastSharedPayload) {
+    Chatroom room;
+    auto members = populate(room, 10'000);
+    std::ostringstream sink;
+    auto* old = std::cout.rdbuf(sink.rdbuf());
+
+    long rss0 = current_rss_kb();
+    auto t0 = bench_clock::now();
+    for (size_t i = 0; i < 1'000; ++i) {
+        members[i % members.size()]->say("the quick brown fox jumps over the lazy dog");
+        sink.str("");
+    }
+    double ms = elapsed_ns(t0) / 1e6;
+    std::cout.rdbuf(old);
+    std::cout << "shared payload: " << ms << " ms, " << (current_rss_kb() - rss0) / 1024 << " MB RSS\n";
+}
+
+// What broadcast cost before: a formatted copy per recipient.
+TEST(ChatroomBenchmark, DISABLED_BroadcastCopyPerRecipient) {
+    Chatroom room;
+    auto members = populate(room, 10'000);
+    std::vector<std::vector<std::string>> copies(members.size());
+    std::ostringstream sink;
+    auto* old = std::cout.rdbuf(sink.rdbuf());
+
+    long rss0 = current_rss_kb();
+    auto t0 = bench_clock::now();
+    for (size_t i = 0; i < 1'000; ++i) {
+        const std::string& origin = members[i % members.size()]->name;
+        for (size_t m = 0; m < members.size(); ++m) {
+            if (members[m]->name == origin) continue;
+            std::string s{origin + ": \"" + "the quick brown fox jumps over the lazy dog" + "\""};
+            copies[m].emplace_back(s);
+            std::cout << "[" << members[m]->name << "'s chat session] " << s << "\n";
+        }
+        sink.str("");
+    }
+    double ms = elapsed_ns(t0) / 1e6;
+    std::cout.rdbuf(old);
+    std::cout << "copy per recipient: " << ms << " ms, " << (current_rss_kb() - rss0) / 1024 << " MB RSS\n";
+}
+
+TEST_F(ChatroomTest, BoundedHistoryKeepsRecentAndDropsOlder) {
+    Chatroom room;
+    Person john("John");
+    Person jane("Jane");
+    jane.messages.set_capacity(2);
+    room.join(&john);
+    room.join(&jane);
+
+    for (const char* text : {"one", "two", "three"}) john.say(text);
+
+    EXPECT_EQ(jane.messages.size(), size_t(4));
+    EXPECT_EQ(jane.messages.first(), size_t(2));
+    EXPECT_EQ(jane.messages[2], "John: \"two\"");
+    EXPECT_EQ(jane.messages[3], "John: \"three\"");
+    EXPECT_THROW(jane.messages[0], std::out_of_range);
+}
+
+TEST_F(ChatroomTest, CaptureObserverMatchesConsoleTranscript) {
+    CaptureObserver capture;
+    Chatroom room;
+    room.observer = &capture;
+    Person john("John");
+    Person jane("Jane");
+    Person bob("Bob");
+    room.join(&john);
+    room.join(&jane);
+    room.join(&bob);
+
+    capture.output.clear();
+    john.say("Hello everyone!");
+    john.pm("Jane", "Hi Jane!");
+
+    EXPECT_EQ(output.str(), ""); // nothing reached std::cout
+    EXPECT_EQ(capture.output, "[Jane's chat session] John: \"Hello everyone!\"\n"
+                              "[Bob's chat session] John: \"Hello everyone!\"\n"
+                              "[Jane's chat session] John: \"Hi Jane!\"\n");
+}
+
+TEST_F(ChatroomTest, BufferedConsoleWritesOnFlush) {
+    Chatroom room;
+    BufferedConsoleObserver buffered;
+    room.observer = &buffered;
+    Person john("John");
+    Person jane("Jane");
+    room.join(&john);
+    room.join(&jane);
+    john.say("Hello!");
+
+    EXPECT_EQ(output.str(), "");
+    buffered.flush();
+    EXPECT_EQ(output.str(), "[John's chat session] room: \"John has joined the chat\"\n"
+                            "[John's chat session] room: \"Jane has joined the chat\"\n"
+                            "[Jane's chat session] room: \"Jane has joined the chat\"\n"
+                            "[Jane's chat session] John: \"Hello!\"\n");
+    EXPECT_EQ(jane.messages.size(), size_t(2)); // history unaffected by the observer
+}
+
+TEST_F(ChatroomTest, TopicReachesOnlySubscribers) {
+    Chatroom room;
+    CaptureObserver capture;
+    room.observer = &capture;
+    Person john("John");
+    Person jane("Jane");
+    Person bob("Bob");
+    room.join(&john);
+    room.join(&jane);
+    room.join(&bob);
+    room.subscribe(&john, "football");
+    room.subscribe(&bob, "football");
+    room.subscribe(&jane, "chess");
+
+    capture.output.clear();
+    room.publish("John", "football", "Goal!");
+    room.publish("Jane", "football", std::vector<std::string>{"one", "two"});
+
+    EXPECT_EQ(capture.output, "[Bob's chat session] John #football: \"Goal!\"\n"
+                              "[John's chat session] Jane #football: \"one\"\n"
+                              "[John's chat session] Jane #football: \"two\"\n"
+                              "[Bob's chat session] Jane #football: \"one\"\n"
+                              "[Bob's chat session] Jane #football: \"two\"\n");
+
+    room.unsubscribe(&bob, "football");
+    capture.output.clear();
+    room.publish("Jane", "football", "Bob left?");
+    EXPECT_EQ(capture.output, "[John's chat session] Jane #football: \"Bob left?\"\n");
+}
+
+TEST_F(ChatroomTest, TopicSubscriptionsFollowSwapAndPop) {
+    Chatroom room;
+    CaptureObserver capture;
+    room.observer = &capture;
+    std::vector<std::unique_ptr<Person>> members;
+    for (int i = 0; i < 70; ++i) { // spans two bitset words
+        members.push_back(std::make_unique<Person>(numbered("p", i)));
+        room.join(members.back().get(), false);
+    }
+    room.subscribe(members[69].get(), "t");
+    room.subscribe(members[3].get(), "t");
+
+    room.leave(members[0].get()); // p69 moves into slot 0
+    room.leave(members[3].get()); // p68 moves into slot 3, unsubscribed
+    capture.output.clear();
+    room.publish("someone", "t", "hi");
+
+    EXPECT_EQ(capture.output, "[p69's chat session] someone #t: \"hi\"\n");
+}
+
+TEST_F(ChatroomTest, SubscriberLeavingFromLastSlotIsUnsubscribed) {
+    Chatroom room;
+    CaptureObserver capture;
+    room.observer = &capture;
+    Person a("A");
+    Person b("B");
+    Person c("C");
+    room.join(&a, false);
+    room.join(&b, false);
+    room.subscribe(&b, "t");
+
+    room.leave(&b); // B holds the last slot
+    room.join(&c, false);
+    capture.output.clear();
+    room.publish("A", "t", "hello");
+    EXPECT_EQ(capture.output, "");
+
+    room.leave(&c);
+    capture.output.clear();
+    room.publish("A", "t", "hello"); // must not read past people
+    EXPECT_EQ(capture.output, "");
+}
+
+TEST(MessageHistoryTest, SpilledMessagesPageBackFromSegment) {
+    const std::string path = testing::TempDir() + "chat_history_" + std::to_string(::getpid()) + ".seg";
+    {
+        HistorySegment segment(path);
+        MessageHistory a(4, &segment), b(4, &segment); // interleaved in one file
+        auto t0 = MessageHistory::clock::time_point{} + std::chrono::seconds(1000);
+        for (int i = 0; i < 100; ++i) {
+            a.push_back(ChatMessage(numbered("a", i)), t0 + std::chrono::seconds(i));
+            b.push_back(ChatMessage(numbered("b", i)), t0 + std::chrono::seconds(i));
+        }
+
+        ASSERT_EQ(a.size(), size_t(100));
+        for (int i = 0; i < 100; ++i) EXPECT_EQ(a[i], numbered("a", i));
+        auto page = b.page(30, 3);
+        ASSERT_EQ(page.size(), size_t(3));
+        EXPECT_EQ(page[0], "b30");
+        EXPECT_EQ(page[2], "b32");
+        EXPECT_EQ(a.index_at(t0 + std::chrono::seconds(64)), size_t(64));
+        EXPECT_EQ(a.index_at(t0 + std::chrono::seconds(500)), size_t(100));
+    }
+    std::remove(path.c_str());
+}
+
+TEST(MessageHistoryTest, SetCapacityKeepsNewestMessages) {
+    MessageHistory history(4);
+    for (int i = 0; i < 6; ++i) history.push_back(ChatMessage(numbered("m", i))); // ring wrapped
+    history.set_capacity(8);
+    history.push_back(ChatMessage("m6"));
+    EXPECT_EQ(history.first(), size_t(2));
+    EXPECT_EQ(history.page(0, 10).front(), "m2");
+    EXPECT_EQ(history[6], "m6");
+
+    history.set_capacity(2);
+    EXPECT_EQ(history.size(), size_t(7));
+    EXPECT_EQ(history.first(), size_t(5));
+    EXPECT_EQ(history[5], "m5");
+    EXPECT_EQ(history[6], "m6");
+    history.push_back(ChatMessage("m7"));
+    EXPECT_EQ(history.first(), size_t(6));
+    EXPECT_EQ(history[7], "m7");
+}
+
+TEST(MessageHistoryTest, ShrinkingSpillsToSegment) {
+    const std::string path = testing::TempDir() + "chat_history_shrink_" + std::to_string(::getpid()) + ".seg";
+    {
+        HistorySegment segment(path);
+        MessageHistory history(4, &segment);
+        for (int i = 0; i < 40; ++i) history.push_back(ChatMessage(numbered("m", i)));
+        history.set_capacity(1, &segment);
+        for (int i = 40; i < 50; ++i) history.push_back(ChatMessage(numbered("m", i)));
+
+        EXPECT_EQ(history.first(), size_t(0));
+        for (int i = 0; i < 50; ++i) EXPECT_EQ(history[i], numbered("m", i));
+
+        history.set_capacity(1); // detached: spilled messages are gone
+        EXPECT_EQ(history.first(), size_t(49));
+        EXPECT_THROW(history[48], std::out_of_range);
+        history.set_capacity(1, &segment); // re-attached: spills start afresh
+        history.push_back(ChatMessage("m50"));
+        EXPECT_EQ(history.first(), size_t(49));
+        EXPECT_EQ(history[49], "m49");
+    }
+    std::remove(path.c_str());
+}
+
+TEST(MessageHistoryTest, FailedSpillIsReportedByFlushNotDestructor) {
+    const std::string path = testing::TempDir() + "chat_history_full_" + std::to_string(::getpid()) + ".seg";
+    // a 64-byte file size limit makes writing the buffered records fail with EFBIG
+    rlimit old_limit;
+    ASSERT_EQ(::getrlimit(RLIMIT_FSIZE, &old_limit), 0);
+    auto old_handler = ::signal(SIGXFSZ, SIG_IGN);
+    rlimit small = old_limit;
+    small.rlim_cur = 64;
+    ASSERT_EQ(::setrlimit(RLIMIT_FSIZE, &small), 0);
+    {
+        HistorySegment segment(path);
+        for (int i = 0; i < 10; ++i) segment.append(numbered("m", i), i, 0);
+        EXPECT_THROW(segment.flush(), std::system_error);
+        segment.append("unwritten", 10, 0);
+    } // the destructor's failed flush must not terminate
+    ::setrlimit(RLIMIT_FSIZE, &old_limit);
+    ::signal(SIGXFSZ, old_handler);
+    std::remove(path.c_str());
+}
+
+TEST(MpscQueueTest, KeepsPerProducerOrder) {
+    constexpr int producers = 4, per_producer = 10'000;
+    MpscQueue<std::pair<int, int>> queue;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&, p] {
+            for (int i = 0; i < per_producer; ++i) queue.push({p, i});
+        });
+    }
+
+    std::vector<int> next(producers, 0);
+    std::pair<int, int> item;
+    for (int received = 0; received < producers * per_producer;) {
+        if (!queue.pop(item)) continue;
+        ASSERT_EQ(item.second, next[item.first]);
+        ++next[item.first];
+        ++received;
+    }
+    for (auto& t : threads) t.join();
+    EXPECT_FALSE(queue.pop(item));
+}
+
+static std::vector<std::string> drain(ShardedChatServer& server, ShardedChatServer::UserId user) {
+    std::vector<std::string> messages;
+    ShardedChatServer::Delivery d;
+    while (server.inbox(user).pop(d)) messages.push_back(d.message.str());
+    return messages;
+}
+
+TEST(ShardedChatServerTest, BroadcastStaysInRoom) {
+    ShardedChatServer server(3, 8);
+    auto john = server.connect("John");
+    auto jane = server.connect("Jane");
+    auto bob = server.connect("Bob");
+    server.join(john, 1);
+    server.join(jane, 1);
+    server.join(bob, 2);
+    server.flush();
+
+    server.say(john, 1, "Hello everyone!");
+    server.flush();
+
+    EXPECT_TRUE(drain(server, john).empty());
+    EXPECT_EQ(drain(server, jane), std::vector<std::string>{"John: \"Hello everyone!\""});
+    EXPECT_TRUE(drain(server, bob).empty());
+}
+
+TEST(ShardedChatServerTest, PrivateMessageCrossesShards) {
+    ShardedChatServer server(2, 8);
+    auto john = server.connect("John"); // shard 0
+    auto jane = server.connect("Jane"); // shard 1
+
+    server.pm(john, jane, "Hi Jane!");
+    server.pm(jane, 42, "nobody here");
+    server.flush();
+
+    EXPECT_EQ(drain(server, jane), std::vector<std::string>{"John: \"Hi Jane!\""});
+    EXPECT_TRUE(drain(server, john).empty());
+}
+
+TEST(ShardedChatServerTest, LeaveStopsDelivery) {
+    ShardedChatServer server(2, 8);
+    auto john = server.connect("John");
+    auto jane = server.connect("Jane");
+    server.join(john, 5);
+    server.join(jane, 5);
+    server.leave(jane, 5);
+    server.say(john, 5, "anyone?");
+    server.flush();
+
+    EXPECT_TRUE(drain(server, jane).empty());
+}
+
+TEST(ShardedChatServerTest, FailedConnectLeavesIdsValid) {
+    ShardedChatServer server(2, 2);
+    auto john = server.connect("John");
+    auto jane = server.connect("Jane");
+    EXPECT_THROW(server.connect("Bob"), std::length_error);
+    EXPECT_THROW(server.connect("Bob"), std::length_error);
+
+    EXPECT_TRUE(server.pm(john, 2, "nobody")); // dropped on the shard, not read past users
+    server.pm(john, jane, "hi");
+    EXPECT_THROW(server.pm(2, jane, "hi"), std::out_of_range);
+    EXPECT_THROW(server.say(5, 0, "hi"), std::out_of_range);
+    EXPECT_THROW(server.join(2, 0), std::out_of_range);
+    server.flush();
+    EXPECT_EQ(drain(server, jane), std::vector<std::string>{"John: \"hi\""});
+}
+
+TEST(ShardedChatServerTest, ZeroShardsOrRoomsAreRejected) {
+    EXPECT_THROW(ShardedChatServer(0, 4), std::invalid_argument);
+    ChatLoadOptions o;
+    o.rooms = 0;
+    EXPECT_THROW(run_chat_load(o), std::invalid_argument);
+    o.rooms = 1;
+    o.shards = 0;
+    EXPECT_THROW(run_chat_load(o), std::invalid_argument);
+    o.shards = 1;
+    o.users = 0;
+    EXPECT_THROW(run_chat_load(o), std::invalid_argument);
+}
+
+// 10k-member room, 200 broadcasts per observer; std::cout goes to /dev/null.
+TEST(ChatroomBenchmark, DISABLED_BroadcastPerObserver) {
+    Chatroom room;
+    auto members = populate(room, 10'000);
+    std::ofstream devnull("/dev/null");
+    auto* old = std::cout.rdbuf(devnull.rdbuf());
+
+    ConsoleObserver& console = ConsoleObserver::instance();
+    NoopObserver noop;
+    BufferedConsoleObserver buffered;
+    CaptureObserver capture;
+    std::vector<std::pair<const char*, DeliveryObserver*>> observers{
+        {"console", &console}, {"buffered console", &buffered}, {"capture", &capture}, {"noop", &noop}};
+
+    std::vector<std::string> results;
+    for (auto [label, observer] : observers) {
+        room.observer = observer;
+        constexpr size_t broadcasts = 200;
+        auto t0 = bench_clock::now();
+        for (size_t i = 0; i < broadcasts; ++i) {
+            members[i % members.size()]->say("the quick brown fox jumps over the lazy dog");
+            capture.output.clear();
+        }
+        buffered.flush();
+        double seconds = elapsed_ns(t0) / 1e9;
+        results.push_back(std::string(label) + ": "
+                          + std::to_string(static_cast<long>(broadcasts * (members.size() - 1) / seconds))
+                          + " deliveries/sec");
+        for (auto& m : members) m->messages.clear();
+    }
+    std::cout.rdbuf(old);
+    for (const auto& r : results) std::cout << r << "\n";
+}
+
+// Topic fan-out in a 10k-member room at several subscriber densities,
+// one message at a time vs bursts of 16.
+TEST(ChatroomBenchmark, DISABLED_TopicFanOut) {
+    Chatroom room;
+    NoopObserver noop;
+    room.observer = &noop;
+    auto members = populate(room, 10'000);
+    constexpr size_t burst_size = 16, bursts = 64;
+    std::vector<std::string> burst(burst_size, "the quick brown fox");
+
+    for (size_t percent : {1, 10, 50, 100}) {
+        const std::string topic = numbered("t", percent);
+        size_t subscribers = 0;
+        for (size_t i = 0; i < members.size(); ++i) {
+            if (i % (100 / percent) == 0) {
+                room.subscribe(members[i].get(), topic);
+                ++subscribers;
+            }
+        }
+
+        auto t0 = bench_clock::now();
+        for (size_t b = 0; b < bursts; ++b) {
+            for (const auto& m : burst) room.publish("nobody", topic, m);
+        }
+        double single = elapsed_ns(t0) / (bursts * burst_size * subscribers);
+
+        t0 = bench_clock::now();
+        for (size_t b = 0; b < bursts; ++b) room.publish("nobody", topic, burst);
+        double batched = elapsed_ns(t0) / (bursts * burst_size * subscribers);
+
+        for (auto& m : members) m->messages.clear();
+        std::cout << percent << "% subscribed (" << subscribers << "): " << single
+                  << " ns per delivery one at a time, " << batched << " ns batched\n";
+    }
+}
+
+// 100k members each receiving CHAT_BENCH_HISTORY messages from rooms of
+// 100, with every message kept in memory vs a 32-message ring spilling to
+// disk. Run the two cases in separate processes.
+static void fill_histories(size_t capacity, HistorySegment* segment) {
+    const size_t members = 100'000, per_member = bench_size("CHAT_BENCH_HISTORY", 200);
+    std::vector<MessageHistory> histories(members, MessageHistory(capacity, segment));
+    long rss0 = current_rss_kb();
+    auto t0 = bench_clock::now();
+    for (size_t round = 0; round < per_member; ++round) {
+        for (size_t room = 0; room < members / 100; ++room) {
+            ChatMessage message(numbered("user", room * 100 + round % 100) + ": \"hello\"");
+            for (size_t m = room * 100; m < room * 100 + 100; ++m) histories[m].push_back(message);
+        }
+    }
+    std::cout << members << " members x " << per_member << " messages, ring " << capacity
+              << (segment ? " + spill" : "") << ": " << elapsed_ns(t0) / 1e6 << " ms, "
+              << (current_rss_kb() - rss0) / 1024 << " MB RSS\n";
+}
+
+TEST(ChatroomBenchmark, DISABLED_HistoryAllInMemory) {
+    fill_histories(bench_size("CHAT_BENCH_HISTORY", 200), nullptr);
+}
+
+TEST(ChatroomBenchmark, DISABLED_HistoryRingWithSpill) {
+    const std::string path = testing::TempDir() + "chat_history_bench.seg";
+    {
+        HistorySegment segment(path);
+        fill_histories(32, &segment);
+    }
+    std::remove(path.c_str());
+}
+
+static std::vector<std::string> fill_unconsumed_inbox(InboxFull policy) {
+    ShardedChatServer server(1, 4, {2, policy});
+    auto john = server.connect("John");
+    auto jane = server.connect("Jane");
+    for (int i = 1; i <= 5; ++i) server.pm(john, jane, std::to_string(i));
+    server.flush();
+    return drain(server, jane);
+}
+
+TEST(ShardedChatServerTest, InboxFullPolicies) {
+    EXPECT_EQ(fill_unconsumed_inbox(InboxFull::drop_new),
+              (std::vector<std::string>{"John: \"1\"", "John: \"2\""}));
+    EXPECT_EQ(fill_unconsumed_inbox(InboxFull::drop_oldest),
+              (std::vector<std::string>{"John: \"4\"", "John: \"5\""}));
+    EXPECT_EQ(fill_unconsumed_inbox(InboxFull::disconnect),
+              (std::vector<std::string>{"John: \"1\"", "John: \"2\""}));
+}
+
+TEST(ShardedChatServerTest, DisconnectedMemberIsDroppedFromRooms) {
+    ShardedChatServer server(2, 4, {2, InboxFull::disconnect});
+    auto john = server.connect("John");
+    auto jane = server.connect("Jane");
+    server.join(john, 0);
+    server.join(jane, 0);
+    for (int i = 0; i < 4; ++i) server.say(john, 0, "spam");
+    server.flush();
+
+    auto stats = server.stats(jane);
+    EXPECT_TRUE(stats.disconnected);
+    EXPECT_EQ(stats.dropped, 1u); // the overflowing message; later ones skip her
+    EXPECT_EQ(drain(server, jane).size(), size_t(2));
+    server.say(john, 0, "anyone?");
+    server.flush();
+    EXPECT_TRUE(drain(server, jane).empty());
+    EXPECT_EQ(server.stats(jane).dropped, 1u); // no longer a room member
+}
+
+TEST(ShardedChatServerTest, SenderRateLimited) {
+    ChatServerOptions options;
+    options.send_rate = 1; // one per second, bursts of three
+    options.send_burst = 3;
+    ShardedChatServer server(1, 4, options);
+    auto john = server.connect("John");
+    auto jane = server.connect("Jane");
+
+    int accepted = 0;
+    for (int i = 0; i < 5; ++i) accepted += server.pm(john, jane, "hi");
+    server.flush();
+
+    EXPECT_EQ(accepted, 3);
+    EXPECT_EQ(server.stats(john).rate_limited, 2u);
+    EXPECT_EQ(drain(server, jane).size(), size_t(3));
+}
+
+// One member's consumer stalls; everyone else must get every message while
+// the slow member loses its oldest ones. The healthy inboxes are drained
+// between rounds smaller than their capacity, so nothing depends on timing.
+TEST(ShardedChatServerTest, SlowMemberDoesNotHoldBackOthers) {
+    constexpr size_t fast_members = 5, rounds = 10, per_round = 100;
+    ChatServerOptions options;
+    options.inbox_capacity = 128;
+    ShardedChatServer server(2, 8, options);
+    auto sender = server.connect("sender");
+    auto slow = server.connect("slow");
+    std::vector<ShardedChatServer::UserId> fast;
+    server.join(sender, 0);
+    server.join(slow, 0);
+    for (size_t i = 0; i < fast_members; ++i) {
+        fast.push_back(server.connect(numbered("fast", i)));
+        server.join(fast.back(), 0);
+    }
+
+    std::vector<size_t> received(fast_members, 0);
+    for (size_t round = 0; round < rounds; ++round) {
+        for (size_t m = 0; m < per_round; ++m) server.say(sender, 0, "tick");
+        server.flush();
+        for (size_t i = 0; i < fast_members; ++i) received[i] += drain(server, fast[i]).size();
+    }
+
+    for (size_t i = 0; i < fast_members; ++i) {
+        EXPECT_EQ(received[i], rounds * per_round);
+        EXPECT_EQ(server.stats(fast[i]).dropped, 0u);
+    }
+    EXPECT_EQ(server.stats(slow).dropped, rounds * per_round - options.inbox_capacity);
+    EXPECT_EQ(drain(server, slow).size(), options.inbox_capacity); // the newest ones
+}
+
+TEST(ShardedChatServerTest, DisconnectedMemberCanReconnect) {
+    ShardedChatServer server(2, 4, {2, InboxFull::disconnect});
+    auto john = server.connect("John");
+    auto jane = server.connect("Jane");
+    server.join(john, 0);
+    server.join(jane, 0);
+    server.join(jane, 1); // never pruned: no traffic in room 1
+    for (int i = 0; i < 3; ++i) server.say(john, 0, "spam");
+    server.flush();
+    ASSERT_TRUE(server.stats(jane).disconnected);
+
+    drain(server, jane);
+    server.reconnect(jane);
+    server.join(jane, 0);
+    server.join(jane, 1);
+    server.say(john, 0, "welcome back");
+    server.say(john, 1, "once");
+    server.flush();
+
+    EXPECT_FALSE(server.stats(jane).disconnected);
+    EXPECT_EQ(drain(server, jane), (std::vector<std::string>{"John: \"welcome back\"", "John: \"once\""}));
+}
+
+// One member's consumer stalls while the others are drained by a live
+// consumer thread; reports the healthy members' delivery latency.
+TEST(ChatroomBenchmark, DISABLED_SlowMemberLatency) {
+    constexpr size_t fast_members = 5, messages = 1'500;
+    ChatServerOptions options;
+    options.inbox_capacity = 512;
+    options.send_rate = 20'000; // paces the producer to ~75 ms
+    options.send_burst = 16;
+    ShardedChatServer server(2, 8, options);
+    auto sender = server.connect("sender");
+    auto slow = server.connect("slow");
+    std::vector<ShardedChatServer::UserId> fast;
+    server.join(sender, 0);
+    server.join(slow, 0);
+    for (size_t i = 0; i < fast_members; ++i) {
+        fast.push_back(server.connect(numbered("fast", i)));
+        server.join(fast.back(), 0);
+    }
+    server.flush();
+
+    std::atomic<bool> done{ false };
+    std::vector<double> latencies_us;
+    std::thread fast_consumer([&] {
+        ShardedChatServer::Delivery d;
+        for (bool last = false; !last;) {
+            last = done.load();
+            for (size_t i = 0; i < fast_members; ++i) {
+                while (server.inbox(fast[i]).pop(d)) {
+                    latencies_us.push_back(std::chrono::duration<double, std::micro>(
+                        ShardedChatServer::clock::now() - d.sent).count());
+                }
+            }
+            std::this_thread::yield();
+        }
+    });
+    std::thread slow_consumer([&] {
+        ShardedChatServer::Delivery d;
+        while (!done.load()) {
+            if (server.inbox(slow).pop(d)) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            else std::this_thread::yield();
+        }
+    });
+
+    for (size_t sent = 0; sent < messages;) {
+        if (server.say(sender, 0, "tick")) ++sent;
+        else std::this_thread::yield();
+    }
+    server.flush();
+    done.store(true);
+    fast_consumer.join();
+    slow_consumer.join();
+
+    uint64_t fast_dropped = 0;
+    for (auto id : fast) fast_dropped += server.stats(id).dropped;
+    std::sort(latencies_us.begin(), latencies_us.end());
+    std::cout << "healthy members p99 delivery latency: "
+              << latencies_us[latencies_us.size() * 99 / 100] << " us, " << fast_dropped
+              << " dropped; slow member dropped " << server.stats(slow).dropped << " of " << messages << "\n";
+}
+
+#ifdef CHATROOM_LOADGEN
+// chat_loadgen [users] [rooms] [shards] [producers] [consumers] [messages per producer]
+int main(int argc, char **argv) {
+    ChatLoadOptions o;
+    size_t* fields[] = { &o.users, &o.rooms, &o.shards, &o.producers, &o.consumers, &o.messages };
+    for (int i = 1; i < argc && i <= 6; ++i) *fields[i - 1] = std::strtoull(argv[i], nullptr, 10);
+    try {
+        return run_chat_load(o);
+    } catch (const std::invalid_argument& e) {
+        std::cerr << "chat_loadgen: " << e.what() << "\n";
+        return 2;
+    }
+}
+#else
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
 }
+#endif
@@ -1,7 +1,36 @@
 #include <iostream>
 #include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <atomic>
+#include <utility>
+#include <exception>
+#include <chrono>
+#include <cstdlib>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <set>
+#include <deque>
+#include <unordered_map>
+#include <string_view>
+#include <cstdint>
+#include <random>
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "boost/signals2.hpp"
 #include <gtest/gtest.h>
+#include "bench.h"
 
 
 struct EventData {
@@ -12,9 +41,13 @@ struct EventData {
 struct PlayerScoredEventData : EventData {
     std::string player_name;
     int goals_scored_so_far;
+    uint32_t team_id = 0;
+    uint32_t match_id = 0;
 
-    PlayerScoredEventData(const std::string& player_name, const int goals_scored_so_far)
-        : player_name(player_name), goals_scored_so_far(goals_scored_so_far) { }
+    PlayerScoredEventData(const std::string& player_name, const int goals_scored_so_far,
+                          uint32_t team_id = 0, uint32_t match_id = 0)
+        : player_name(player_name), goals_scored_so_far(goals_scored_so_far),
+          team_id(team_id), match_id(match_id) { }
 
     void print() const override {
         std::cout << player_name << " has scored! (their " << goals_scored_so_far
@@ -23,41 +56,545 @@ struct PlayerScoredEventData : EventData {
     }
 };
 
+// Type-indexed event bus: handlers subscribe to one concrete event type and
+// emit() walks that type's flat handler vector, so no dynamic_cast, no slot
+// list copy and no mutex on the emit path. Subscribing and unsubscribing are
+// not synchronized with emitting; wire up subscribers before events start
+// flowing, and don't drop a Subscription from inside a handler.
+class EventBus {
+    struct HandlerListBase {
+        virtual ~HandlerListBase() = default;
+        virtual void remove(uint64_t key) = 0;
+    };
+
+    template <typename E>
+    struct HandlerList : HandlerListBase {
+        std::vector<std::function<void(const E&)>> handlers;
+        std::vector<uint64_t> keys; // parallel to handlers
+
+        void remove(uint64_t key) override {
+            auto it = std::find(keys.begin(), keys.end(), key);
+            if (it == keys.end()) return;
+            handlers.erase(handlers.begin() + (it - keys.begin()));
+            keys.erase(it);
+        }
+    };
+
+    std::vector<std::unique_ptr<HandlerListBase>> lists; // indexed by type_id<E>()
+    uint64_t next_key = 0;
+
+    static size_t next_type_id() {
+        static std::atomic<size_t> counter{0};
+        return counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    template <typename E>
+    static size_t type_id() {
+        static const size_t id = next_type_id();
+        return id;
+    }
+
+public:
+    // Removes its handler when destroyed. The bus must outlive it.
+    class Subscription {
+        EventBus* bus = nullptr;
+        size_t type = 0;
+        uint64_t key = 0;
+
+        friend class EventBus;
+        Subscription(EventBus* bus, size_t type, uint64_t key) : bus(bus), type(type), key(key) { }
+
+    public:
+        Subscription() = default;
+        Subscription(Subscription&& other) noexcept
+            : bus(std::exchange(other.bus, nullptr)), type(other.type), key(other.key) { }
+        Subscription& operator=(Subscription&& other) noexcept {
+            if (this != &other) {
+                reset();
+                bus = std::exchange(other.bus, nullptr);
+                type = other.type;
+                key = other.key;
+            }
+            return *this;
+        }
+        ~Subscription() { reset(); }
+
+        void reset() {
+            if (bus) bus->lists[type]->remove(key);
+            bus = nullptr;
+        }
+    };
+
+    EventBus() = default;
+    EventBus(const EventBus&) = delete; // subscriptions point at the bus
+    EventBus& operator=(const EventBus&) = delete;
+
+    template <typename E, typename F>
+    [[nodiscard]] Subscription subscribe(F&& handler) {
+        size_t id = type_id<E>();
+        if (lists.size() <= id) lists.resize(id + 1);
+        if (!lists[id]) lists[id] = std::make_unique<HandlerList<E>>();
+        auto& list = static_cast<HandlerList<E>&>(*lists[id]);
+        list.handlers.emplace_back(std::forward<F>(handler));
+        list.keys.push_back(next_key);
+        return Subscription(this, id, next_key++);
+    }
+
+    template <typename E>
+    void emit(const E& event) const {
+        size_t id = type_id<E>();
+        if (id >= lists.size() || !lists[id]) return;
+        for (const auto& handler : static_cast<const HandlerList<E>&>(*lists[id]).handlers) {
+            handler(event);
+        }
+    }
+};
+
+// Delivers events of type E on background workers. post() copies the event
+// into a preallocated ring, so it outlives the caller's stack frame, and
+// blocks only when the ring is full. Handlers are spread over the workers;
+// each worker walks the ring in order and drains up to `batch` events per
+// wake-up, so every handler sees events in posting order. Like EventBus,
+// subscribe before posting. An exception from a handler is caught on the
+// worker, which goes on delivering; flush() rethrows the first one.
+template <typename E>
+class AsyncDispatcher {
+    std::vector<std::optional<E>> ring;
+    std::vector<std::vector<std::function<void(const E&)>>> handlers; // per worker
+    std::vector<uint64_t> cursors;  // per worker: next sequence to deliver
+    uint64_t tail = 0;              // next sequence to write
+    size_t batch;
+    size_t next_worker = 0;
+    bool stopping = false;
+    std::exception_ptr handler_error; // first exception thrown by a handler
+    std::mutex mtx;
+    std::condition_variable not_empty, not_full;
+    std::vector<std::thread> workers;
+
+    uint64_t slowest() const { return *std::min_element(cursors.begin(), cursors.end()); }
+
+    void run(size_t w) {
+        std::unique_lock lock(mtx);
+        for (;;) {
+            not_empty.wait(lock, [&] { return stopping || cursors[w] < tail; });
+            if (cursors[w] == tail) return; // stopping and drained
+            uint64_t begin = cursors[w];
+            uint64_t end = std::min(tail, begin + batch);
+            lock.unlock();
+            // slots in [begin, end) can't be overwritten until cursors[w] moves
+            std::exception_ptr error;
+            for (uint64_t seq = begin; seq < end; ++seq) {
+                const E& event = *ring[seq % ring.size()];
+                for (const auto& handler : handlers[w]) {
+                    try {
+                        handler(event);
+                    } catch (...) {
+                        if (!error) error = std::current_exception();
+                    }
+                }
+            }
+            lock.lock();
+            if (error && !handler_error) handler_error = error;
+            cursors[w] = end;
+            not_full.notify_all();
+        }
+    }
+
+public:
+    // Throws std::invalid_argument if any argument is zero.
+    explicit AsyncDispatcher(size_t capacity = 4096, size_t worker_count = 1, size_t batch = 64)
+        : ring(capacity), handlers(worker_count), cursors(worker_count, 0), batch(batch) {
+        if (capacity == 0) throw std::invalid_argument("AsyncDispatcher capacity must be positive");
+        if (worker_count == 0) throw std::invalid_argument("AsyncDispatcher needs at least one worker");
+        if (batch == 0) throw std::invalid_argument("AsyncDispatcher batch must be positive");
+        for (size_t w = 0; w < worker_count; ++w) workers.emplace_back(&AsyncDispatcher::run, this, w);
+    }
+
+    AsyncDispatcher(const AsyncDispatcher&) = delete;
+    AsyncDispatcher& operator=(const AsyncDispatcher&) = delete;
+
+    ~AsyncDispatcher() {
+        {
+            std::lock_guard lock(mtx);
+            stopping = true;
+        }
+        not_empty.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    template <typename F>
+    void subscribe(F&& handler) {
+        handlers[next_worker++ % handlers.size()].emplace_back(std::forward<F>(handler));
+    }
+
+    void post(const E& event) {
+        {
+            std::unique_lock lock(mtx);
+            not_full.wait(lock, [&] { return tail - slowest() < ring.size(); });
+            ring[tail % ring.size()] = event;
+            ++tail;
+        }
+        not_empty.notify_all();
+    }
+
+    // Blocks until everything posted so far has been delivered, then
+    // rethrows the first handler exception not yet reported.
+    void flush() {
+        std::unique_lock lock(mtx);
+        not_full.wait(lock, [&] { return slowest() == tail; });
+        if (handler_error) std::rethrow_exception(std::exchange(handler_error, nullptr));
+    }
+};
+
 struct Game {
-    boost::signals2::signal<void(EventData*)> events; // observer
+    uint32_t match_id = 0;
+    boost::signals2::signal<void(EventData*)> events; // observer, untyped
+    EventBus bus;                                     // observer, typed
+    std::unique_ptr<AsyncDispatcher<PlayerScoredEventData>> async; // set by dispatch_async()
+
+    // Deliver scored events to bus and events subscribers, and announce
+    // them on std::cout, on a background thread instead of inside
+    // Player::score.
+    void dispatch_async(size_t capacity = 4096, size_t batch = 64) {
+        async = std::make_unique<AsyncDispatcher<PlayerScoredEventData>>(capacity, 1, batch);
+        async->subscribe([this](const PlayerScoredEventData& e) { deliver(e); });
+    }
+
+    void deliver(const PlayerScoredEventData& e) {
+        e.print();
+        bus.emit(e);
+        if (!events.empty()) {
+            PlayerScoredEventData copy = e; // signals2 slots take a mutable pointer
+            events(&copy);
+        }
+    }
+
+    void publish(const PlayerScoredEventData& e) {
+        if (async) async->post(e);
+        else deliver(e);
+    }
 };
 
 struct Player {
     std::string name;
     int goals_scored = 0;
     Game& game;
+    uint32_t team_id = 0;
 
-    Player(const std::string& name, Game& game)
-        : name(name), game(game) { }
+    Player(const std::string& name, Game& game, uint32_t team_id = 0)
+        : name(name), game(game), team_id(team_id) { }
 
     void score() {
         ++goals_scored;
-        PlayerScoredEventData event_data(name, goals_scored);
-        event_data.print();
-        game.events(&event_data);
+        game.publish(PlayerScoredEventData(name, goals_scored, team_id, game.match_id));
     }
 };
 
 struct Coach {
     Game& game;
+    EventBus::Subscription subscription;
 
     explicit Coach(Game& game) : game(game) {
         // celebrate if player has scored < 3 goals
-        game.events.connect([](EventData* event_data) {
-            auto ps = dynamic_cast<PlayerScoredEventData*>(event_data);
-            if (ps && ps->goals_scored_so_far < 3) {
-                std::cout << "coach says: Well done! " << ps->player_name
+        subscription = game.bus.subscribe<PlayerScoredEventData>([](const PlayerScoredEventData& ps) {
+            if (ps.goals_scored_so_far < 3) {
+                std::cout << "coach says: Well done! " << ps.player_name
                           << "\n";
             }
         });
     }
 };
 
+// Compact scored-goal record for bulk replay; player ids come from
+// ScoreStatistics::player_id().
+struct ScoreRecord {
+    uint32_t player_id, team_id, match_id;
+};
+
+// Live scoring aggregates. Players get dense ids on first sight and every
+// counter is a plain array indexed by id (structure of arrays). The
+// leaderboard is an ordered set updated in O(log n) per goal.
+class ScoreStatistics {
+public:
+    using id_type = uint32_t;
+
+    ScoreStatistics() = default;
+    explicit ScoreStatistics(Game& game)
+        : subscription(game.bus.subscribe<PlayerScoredEventData>([this](const PlayerScoredEventData& e) {
+              on_scored(e);
+          })) { }
+
+    ScoreStatistics(const ScoreStatistics&) = delete;
+    ScoreStatistics& operator=(const ScoreStatistics&) = delete;
+
+    id_type player_id(std::string_view name, id_type team_id = 0) {
+        auto it = ids.find(name);
+        if (it != ids.end()) return it->second;
+        id_type id = static_cast<id_type>(names.size());
+        names.emplace_back(name);
+        ids.emplace(names.back(), id);
+        player_goals.push_back(0);
+        player_team.push_back(team_id);
+        leaderboard.insert({0, id});
+        return id;
+    }
+
+    void on_scored(const PlayerScoredEventData& e) {
+        record({player_id(e.player_name, e.team_id), e.team_id, e.match_id});
+    }
+
+    // Throws std::out_of_range for a player id not handed out by player_id().
+    void record(const ScoreRecord& r) {
+        check_player(r.player_id);
+        auto node = leaderboard.extract({player_goals[r.player_id], r.player_id});
+        node.value().goals = ++player_goals[r.player_id];
+        leaderboard.insert(std::move(node)); // reuses the node, no allocation
+        player_team[r.player_id] = r.team_id;
+        bump(team_goals, r.team_id);
+        bump(match_goals, r.match_id);
+    }
+
+    // Applies a stored event log, then rebuilds the leaderboard once (one
+    // sort, then inserts in order at end(), each amortised O(1)) instead of
+    // paying O(log n) per record. Every player id is checked first, so a
+    // bad log throws std::out_of_range without applying any of it.
+    void replay(const std::vector<ScoreRecord>& log) {
+        for (const auto& r : log) check_player(r.player_id);
+        for (const auto& r : log) {
+            ++player_goals[r.player_id];
+            player_team[r.player_id] = r.team_id;
+            bump(team_goals, r.team_id);
+            bump(match_goals, r.match_id);
+        }
+        std::vector<Entry> entries;
+        entries.reserve(player_goals.size());
+        for (id_type id = 0; id < player_goals.size(); ++id) entries.push_back({player_goals[id], id});
+        std::sort(entries.begin(), entries.end());
+        leaderboard.clear();
+        for (const Entry& entry : entries) leaderboard.insert(leaderboard.end(), entry);
+    }
+
+    uint32_t goals(id_type player) const { return player_goals.at(player); }
+    uint32_t team(id_type player) const { return player_team.at(player); }
+    uint32_t goals_by_team(id_type team) const { return team < team_goals.size() ? team_goals[team] : 0; }
+    uint32_t goals_in_match(id_type match) const { return match < match_goals.size() ? match_goals[match] : 0; }
+
+    std::vector<std::pair<std::string_view, uint32_t>> top(size_t k) const {
+        std::vector<std::pair<std::string_view, uint32_t>> result;
+        for (auto it = leaderboard.begin(); it != leaderboard.end() && result.size() < k; ++it) {
+            result.emplace_back(names[it->id], it->goals);
+        }
+        return result;
+    }
+
+private:
+    struct Entry {
+        uint32_t goals;
+        id_type id;
+        bool operator<(const Entry& o) const { // most goals first, then lowest id
+            return goals != o.goals ? goals > o.goals : id < o.id;
+        }
+    };
+
+    struct NameHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    };
+
+    void check_player(id_type id) const {
+        if (id >= player_goals.size()) throw std::out_of_range("unknown player id " + std::to_string(id));
+    }
+
+    static void bump(std::vector<uint32_t>& counters, id_type id) {
+        if (counters.size() <= id) counters.resize(id + 1, 0);
+        ++counters[id];
+    }
+
+    std::deque<std::string> names; // deque keeps the map's string_view keys valid
+    std::unordered_map<std::string_view, id_type, NameHash, std::equal_to<>> ids;
+    std::vector<uint32_t> player_goals, player_team, team_goals, match_goals;
+    std::set<Entry> leaderboard;
+    EventBus::Subscription subscription; // last: unsubscribes before the members go
+};
+
+// On-disk layout of one scored event. Player names are interned: name_id
+// indexes the string table kept next to the log in "<path>.names" as
+// [u32 length][bytes] entries, in id order.
+struct EventLogRecord {
+    uint32_t name_id;
+    int32_t goals_scored_so_far;
+    uint32_t team_id;
+    uint32_t match_id;
+};
+static_assert(sizeof(EventLogRecord) == 16, "EventLogRecord is a fixed on-disk layout");
+
+constexpr char event_log_magic[16] = "FOOTBALL-EVLOG1";
+
+// Appends every event published on a game's bus to an append-only log.
+// Records are buffered; flush() writes new names before the records that
+// use them, so a log on disk never refers to an unknown name. Opening an
+// existing log continues it: torn tails left by a crash are cut off and
+// name ids carry on from its string table.
+class EventLogWriter {
+    std::ofstream records, names;
+    std::unordered_map<std::string, uint32_t> name_ids;
+    std::vector<EventLogRecord> buffer;
+    static constexpr size_t buffer_records = 4096;
+    EventBus::Subscription subscription;
+
+    // Loads the existing string table and returns the size of its whole entries.
+    uintmax_t load_names(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        uintmax_t valid = 0;
+        uint32_t len;
+        while (in.read(reinterpret_cast<char*>(&len), sizeof(len))) {
+            std::string name(len, '\0');
+            if (!in.read(name.data(), len)) break;
+            name_ids.emplace(std::move(name), static_cast<uint32_t>(name_ids.size()));
+            valid += sizeof(len) + len;
+        }
+        return valid;
+    }
+
+    // Size of the magic header plus the whole records of an existing log.
+    static uintmax_t valid_log_size(const std::string& path) {
+        std::error_code ec;
+        uintmax_t size = std::filesystem::file_size(path, ec);
+        if (ec || size < sizeof(event_log_magic)) return 0; // missing, or crashed before the header
+        char magic[sizeof(event_log_magic)];
+        std::ifstream(path, std::ios::binary).read(magic, sizeof(magic));
+        if (std::memcmp(magic, event_log_magic, sizeof(magic)) != 0) {
+            throw std::runtime_error("not an event log: " + path);
+        }
+        return size - (size - sizeof(event_log_magic)) % sizeof(EventLogRecord);
+    }
+
+public:
+    explicit EventLogWriter(const std::string& path) {
+        uintmax_t log_size = valid_log_size(path);
+        uintmax_t names_size = log_size ? load_names(path + ".names") : 0;
+        std::ofstream(path, std::ios::binary | std::ios::app).close(); // create if missing
+        std::ofstream(path + ".names", std::ios::binary | std::ios::app).close();
+        std::filesystem::resize_file(path, log_size);
+        std::filesystem::resize_file(path + ".names", names_size);
+
+        records.open(path, std::ios::binary | std::ios::app);
+        names.open(path + ".names", std::ios::binary | std::ios::app);
+        if (!records || !names) throw std::runtime_error("cannot open event log " + path);
+        if (log_size == 0) records.write(event_log_magic, sizeof(event_log_magic));
+        buffer.reserve(buffer_records);
+    }
+
+    EventLogWriter(Game& game, const std::string& path) : EventLogWriter(path) {
+        subscription = game.bus.subscribe<PlayerScoredEventData>([this](const PlayerScoredEventData& e) { append(e); });
+    }
+
+    EventLogWriter(const EventLogWriter&) = delete;
+    EventLogWriter& operator=(const EventLogWriter&) = delete;
+
+    // Call flush() before destruction to see write errors; the destructor
+    // can only drop them.
+    ~EventLogWriter() {
+        try {
+            flush();
+        } catch (const std::exception&) {
+        }
+    }
+
+    void append(const PlayerScoredEventData& e) {
+        auto [it, inserted] = name_ids.try_emplace(e.player_name, static_cast<uint32_t>(name_ids.size()));
+        if (inserted) {
+            uint32_t len = static_cast<uint32_t>(e.player_name.size());
+            names.write(reinterpret_cast<const char*>(&len), sizeof(len));
+            names.write(e.player_name.data(), len);
+        }
+        buffer.push_back({it->second, e.goals_scored_so_far, e.team_id, e.match_id});
+        if (buffer.size() == buffer_records) flush();
+    }
+
+    // Throws std::runtime_error if either file could not be written.
+    void flush() {
+        names.flush();
+        if (!names) throw std::runtime_error("event log: cannot write name table");
+        records.write(reinterpret_cast<const char*>(buffer.data()),
+                      static_cast<std::streamsize>(buffer.size() * sizeof(EventLogRecord)));
+        records.flush();
+        if (!records) throw std::runtime_error("event log: cannot write records");
+        buffer.clear();
+    }
+};
+
+// Memory-maps a log written by EventLogWriter and re-emits it. Replay reuses
+// one event object, so names up to the longest seen cost no allocation.
+class EventLogReader {
+    std::vector<std::string> names;
+    const char* mapping = nullptr;
+    size_t mapping_size = 0;
+
+public:
+    explicit EventLogReader(const std::string& path) {
+        std::ifstream name_file(path + ".names", std::ios::binary);
+        uint32_t len;
+        while (name_file.read(reinterpret_cast<char*>(&len), sizeof(len))) {
+            std::string name(len, '\0');
+            if (!name_file.read(name.data(), len)) break;
+            names.push_back(std::move(name));
+        }
+
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("cannot open event log " + path);
+        struct stat st{};
+        if (::fstat(fd, &st) != 0) {
+            ::close(fd);
+            throw std::runtime_error("cannot stat event log " + path);
+        }
+        mapping_size = static_cast<size_t>(st.st_size);
+        if (mapping_size > 0) {
+            void* m = ::mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            mapping = m == MAP_FAILED ? nullptr : static_cast<const char*>(m);
+        }
+        ::close(fd);
+        if (!mapping || mapping_size < sizeof(event_log_magic)
+            || std::memcmp(mapping, event_log_magic, sizeof(event_log_magic)) != 0) {
+            if (mapping) ::munmap(const_cast<char*>(mapping), mapping_size);
+            throw std::runtime_error("not an event log: " + path);
+        }
+        ::madvise(const_cast<char*>(mapping), mapping_size, MADV_SEQUENTIAL);
+    }
+
+    EventLogReader(const EventLogReader&) = delete;
+    EventLogReader& operator=(const EventLogReader&) = delete;
+
+    ~EventLogReader() { ::munmap(const_cast<char*>(mapping), mapping_size); }
+
+    // Whole records only; a torn tail from a crash is ignored.
+    size_t size() const { return (mapping_size - sizeof(event_log_magic)) / sizeof(EventLogRecord); }
+
+    const EventLogRecord* begin() const {
+        return reinterpret_cast<const EventLogRecord*>(mapping + sizeof(event_log_magic));
+    }
+    const EventLogRecord* end() const { return begin() + size(); }
+
+    std::string_view name(uint32_t id) const { return names.at(id); }
+
+    // Re-emits every logged event to the typed subscribers of `bus`. Throws
+    // std::runtime_error at a record whose name is missing from the table.
+    size_t replay(const EventBus& bus) const {
+        PlayerScoredEventData event("", 0);
+        for (const auto& r : *this) {
+            if (r.name_id >= names.size()) {
+                throw std::runtime_error("event log refers to unknown name id " + std::to_string(r.name_id));
+            }
+            event.player_name.assign(names[r.name_id]);
+            event.goals_scored_so_far = r.goals_scored_so_far;
+            event.team_id = r.team_id;
+            event.match_id = r.match_id;
+            bus.emit(event);
+        }
+        return size();
+    }
+};
+
 class FootballTest : public ::testing::Test {
 protected:
     void SetUp() override {
@@ -140,6 +677,416 @@ TEST_F(FootballTest, PlayerGoalsCount) {
     EXPECT_EQ(player.goals_scored, 2);
 }
 
+TEST_F(FootballTest, SignalSubscribersStillNotified) {
+    Game game;
+    Player player("John", game);
+    int notified = 0;
+    game.events.connect([&](EventData* event_data) {
+        if (dynamic_cast<PlayerScoredEventData*>(event_data)) ++notified;
+    });
+
+    player.score();
+
+    EXPECT_EQ(notified, 1);
+}
+
+TEST_F(FootballTest, AsyncDispatchDeliversAfterFlush) {
+    Game game;
+    game.dispatch_async(4, 2);
+    Player player("John", game);
+    std::vector<int> seen;
+    auto subscription = game.bus.subscribe<PlayerScoredEventData>([&](const PlayerScoredEventData& e) {
+        seen.push_back(e.goals_scored_so_far);
+    });
+
+    for (int i = 0; i < 10; ++i) player.score(); // more events than ring slots
+    game.async->flush();
+
+    std::vector<int> expected{1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    EXPECT_EQ(seen, expected);
+}
+
+TEST(AsyncDispatcherTest, EachHandlerSeesEventsInOrderAcrossWorkers) {
+    constexpr int handlers = 4, events = 1000;
+    std::vector<std::vector<int>> seen(handlers);
+    {
+        AsyncDispatcher<int> dispatcher(16, 3, 5);
+        for (int h = 0; h < handlers; ++h) {
+            dispatcher.subscribe([&, h](const int& e) { seen[h].push_back(e); });
+        }
+        for (int i = 0; i < events; ++i) dispatcher.post(i);
+    } // destructor drains
+
+    for (const auto& s : seen) {
+        ASSERT_EQ(s.size(), size_t(events));
+        EXPECT_TRUE(std::is_sorted(s.begin(), s.end()));
+    }
+}
+
+TEST(AsyncDispatcherTest, HandlerExceptionIsReportedByFlush) {
+    std::vector<int> seen;
+    AsyncDispatcher<int> dispatcher(8, 2);
+    dispatcher.subscribe([](const int& e) {
+        if (e == 2) throw std::runtime_error("bad event");
+    });
+    dispatcher.subscribe([&](const int& e) { seen.push_back(e); });
+    for (int i = 1; i <= 3; ++i) dispatcher.post(i);
+
+    EXPECT_THROW(dispatcher.flush(), std::runtime_error);
+    EXPECT_EQ(seen, (std::vector<int>{1, 2, 3})); // other worker unaffected
+    dispatcher.post(4);
+    EXPECT_NO_THROW(dispatcher.flush());         // reported once
+}
+
+TEST(AsyncDispatcherTest, ZeroSizesAreRejected) {
+    EXPECT_THROW(AsyncDispatcher<int>(0, 1), std::invalid_argument);
+    EXPECT_THROW(AsyncDispatcher<int>(8, 0), std::invalid_argument);
+    EXPECT_THROW(AsyncDispatcher<int>(8, 1, 0), std::invalid_argument);
+}
+
+TEST_F(FootballTest, AsyncDispatchPrintsOnWorker) {
+    Game game;
+    game.dispatch_async();
+    Player player("John", game);
+    player.score();
+    game.async->flush();
+    EXPECT_EQ(output.str(), "John has scored! (their 1 goal)\n");
+}
+
+TEST(AsyncDispatcherTest, SlowSubscriberDoesNotRunOnPostingThread) {
+    auto poster = std::this_thread::get_id();
+    std::thread::id handler_thread;
+    AsyncDispatcher<int> dispatcher;
+    dispatcher.subscribe([&](const int&) { handler_thread = std::this_thread::get_id(); });
+    dispatcher.post(1);
+    dispatcher.flush();
+    EXPECT_NE(handler_thread, poster);
+}
+
+TEST_F(FootballTest, StatisticsFollowGameEvents) {
+    Game game;
+    game.match_id = 7;
+    ScoreStatistics stats(game);
+    Player john("John", game, 1);
+    Player jane("Jane", game, 2);
+    Player bob("Bob", game, 1);
+
+    john.score();
+    jane.score();
+    jane.score();
+    bob.score();
+
+    auto top = stats.top(2);
+    ASSERT_EQ(top.size(), size_t(2));
+    EXPECT_EQ(top[0], (std::pair<std::string_view, uint32_t>{"Jane", 2}));
+    EXPECT_EQ(top[1], (std::pair<std::string_view, uint32_t>{"John", 1}));
+    EXPECT_EQ(stats.goals_by_team(1), 2u);
+    EXPECT_EQ(stats.goals_by_team(2), 2u);
+    EXPECT_EQ(stats.goals_in_match(7), 4u);
+    EXPECT_EQ(stats.goals_in_match(8), 0u);
+}
+
+static std::string numbered(std::string prefix, uint32_t n) {
+    return prefix += std::to_string(n);
+}
+
+TEST(ScoreStatisticsTest, ReplayMatchesIncrementalUpdates) {
+    ScoreStatistics live, replayed;
+    std::vector<ScoreRecord> log;
+    std::mt19937 rng(42);
+    for (int p = 0; p < 50; ++p) {
+        live.player_id(numbered("p", p), p % 5);
+        replayed.player_id(numbered("p", p), p % 5);
+    }
+    for (int i = 0; i < 2000; ++i) {
+        uint32_t p = rng() % 50;
+        log.push_back({p, p % 5, static_cast<uint32_t>(i / 100)});
+        live.record(log.back());
+    }
+    replayed.replay(log);
+
+    EXPECT_EQ(live.top(10), replayed.top(10));
+    for (uint32_t t = 0; t < 5; ++t) EXPECT_EQ(live.goals_by_team(t), replayed.goals_by_team(t));
+    for (uint32_t m = 0; m < 20; ++m) EXPECT_EQ(live.goals_in_match(m), replayed.goals_in_match(m));
+}
+
+TEST(ScoreStatisticsTest, UnknownPlayerIdIsRejected) {
+    ScoreStatistics stats;
+    auto john = stats.player_id("John", 1);
+    EXPECT_THROW(stats.record({john + 1, 1, 0}), std::out_of_range);
+    EXPECT_THROW(stats.replay({{john, 1, 0}, {7, 1, 0}}), std::out_of_range);
+
+    EXPECT_EQ(stats.goals(john), 0u); // the bad replay applied nothing
+    EXPECT_EQ(stats.goals_by_team(1), 0u);
+    stats.record({john, 1, 0});
+    EXPECT_EQ(stats.top(1).at(0).second, 1u);
+}
+
+TEST_F(FootballTest, EventLogReplaysIntoNewGame) {
+    const std::string path = testing::TempDir() + "football_events_" + std::to_string(::getpid()) + ".log";
+    {
+        Game game;
+        game.match_id = 3;
+        EventLogWriter log(game, path);
+        Player john("John", game, 1);
+        Player jane("Jane", game, 2);
+        john.score();
+        jane.score();
+        john.score();
+    }
+
+    Game restarted;
+    ScoreStatistics stats(restarted);
+    EventLogReader reader(path);
+    std::vector<std::string> seen;
+    auto subscription = restarted.bus.subscribe<PlayerScoredEventData>([&](const PlayerScoredEventData& e) {
+        seen.push_back(e.player_name + "#" + std::to_string(e.goals_scored_so_far));
+    });
+
+    EXPECT_EQ(reader.replay(restarted.bus), size_t(3));
+    std::vector<std::string> expected{"John#1", "Jane#1", "John#2"};
+    EXPECT_EQ(seen, expected);
+    EXPECT_EQ(stats.goals_by_team(1), 2u);
+    EXPECT_EQ(stats.goals_in_match(3), 3u);
+    EXPECT_EQ(reader.name(reader.begin()[1].name_id), "Jane");
+
+    std::remove(path.c_str());
+    std::remove((path + ".names").c_str());
+}
+
+TEST(EventLogTest, NewWriterContinuesExistingLog) {
+    const std::string path = testing::TempDir() + "football_continue_" + std::to_string(::getpid()) + ".log";
+    std::remove(path.c_str());
+    std::remove((path + ".names").c_str());
+    {
+        EventLogWriter log(path);
+        log.append(PlayerScoredEventData("John", 1));
+        log.append(PlayerScoredEventData("Jane", 1));
+    }
+    std::ofstream(path, std::ios::binary | std::ios::app).write("torn", 4);
+    std::ofstream(path + ".names", std::ios::binary | std::ios::app).write("\x09\0\0\0Ji", 6);
+    {
+        EventLogWriter log(path); // restart
+        log.append(PlayerScoredEventData("John", 2));
+        log.append(PlayerScoredEventData("Bob", 1));
+    }
+
+    EventLogReader reader(path);
+    EventBus bus;
+    std::vector<std::string> seen;
+    auto subscription = bus.subscribe<PlayerScoredEventData>([&](const PlayerScoredEventData& e) {
+        seen.push_back(e.player_name + "#" + std::to_string(e.goals_scored_so_far));
+    });
+    EXPECT_EQ(reader.replay(bus), size_t(4));
+    EXPECT_EQ(seen, (std::vector<std::string>{"John#1", "Jane#1", "John#2", "Bob#1"}));
+    EXPECT_EQ(reader.begin()[2].name_id, 0u); // John keeps his id
+    EXPECT_EQ(reader.name(2), "Bob");
+
+    std::remove(path.c_str());
+    std::remove((path + ".names").c_str());
+}
+
+TEST(EventLogTest, RecordWithUnknownNameIsRejected) {
+    const std::string path = testing::TempDir() + "football_torn_names_" + std::to_string(::getpid()) + ".log";
+    {
+        EventLogWriter log(path);
+        log.append(PlayerScoredEventData("John", 1));
+    }
+    std::filesystem::resize_file(path + ".names", 2); // lose John's entry
+
+    EventLogReader reader(path);
+    EventBus bus;
+    EXPECT_THROW(reader.replay(bus), std::runtime_error);
+    std::remove(path.c_str());
+    std::remove((path + ".names").c_str());
+}
+
+TEST(EventLogTest, RejectsForeignFile) {
+    const std::string path = testing::TempDir() + "football_not_a_log_" + std::to_string(::getpid());
+    std::ofstream(path) << "hello, this is not an event log";
+    EXPECT_THROW(EventLogReader{path}, std::runtime_error);
+    std::remove(path.c_str());
+}
+
+struct MatchEndedEventData {
+    int home, away;
+};
+
+TEST(EventBusTest, DispatchesOnlyToSubscribersOfTheEventType) {
+    EventBus bus;
+    std::vector<std::string> seen;
+    auto s1 = bus.subscribe<PlayerScoredEventData>([&](const PlayerScoredEventData& e) { seen.push_back("scored " + e.player_name); });
+    auto s2 = bus.subscribe<MatchEndedEventData>([&](const MatchEndedEventData& e) { seen.push_back("ended " + std::to_string(e.home)); });
+    auto s3 = bus.subscribe<PlayerScoredEventData>([&](const PlayerScoredEventData&) { seen.push_back("second"); });
+
+    bus.emit(PlayerScoredEventData{"John", 1});
+    bus.emit(MatchEndedEventData{2, 1});
+
+    std::vector<std::string> expected{"scored John", "second", "ended 2"};
+    EXPECT_EQ(seen, expected);
+}
+
+TEST(EventBusTest, EmitWithoutSubscribersIsNoop) {
+    EventBus bus;
+    int calls = 0;
+    auto subscription = bus.subscribe<PlayerScoredEventData>([&](const PlayerScoredEventData&) { ++calls; });
+    bus.emit(MatchEndedEventData{0, 0}); // no handler list for this type
+    subscription.reset();
+    bus.emit(PlayerScoredEventData{"John", 1});
+    EXPECT_EQ(calls, 0);
+}
+
+TEST(EventBusTest, SubscriptionRemovesOnlyItsHandler) {
+    EventBus bus;
+    std::vector<std::string> seen;
+    auto first = bus.subscribe<PlayerScoredEventData>([&](const PlayerScoredEventData&) { seen.push_back("first"); });
+    {
+        auto second = bus.subscribe<PlayerScoredEventData>([&](const PlayerScoredEventData&) { seen.push_back("second"); });
+        auto third = std::move(second); // moved-from handle removes nothing
+        bus.emit(PlayerScoredEventData{"John", 1});
+    }
+    bus.emit(PlayerScoredEventData{"John", 2});
+
+    std::vector<std::string> expected{"first", "second", "first"};
+    EXPECT_EQ(seen, expected);
+}
+
+TEST_F(FootballTest, StatisticsDestroyedBeforeGameStopsListening) {
+    Game game;
+    Player john("John", game);
+    {
+        ScoreStatistics stats(game);
+        john.score();
+        EXPECT_EQ(stats.goals(0), 1u);
+    }
+    john.score(); // would call into the destroyed stats without unsubscribe
+    EXPECT_EQ(john.goals_scored, 2);
+}
+
+// Benchmarks are disabled by default, run them with:
+//   ./football --gtest_also_run_disabled_tests --gtest_filter='FootballBenchmark.*'
+// FOOTBALL_BENCH_DELIVERIES sets the handler calls per case (default 10M).
+TEST(FootballBenchmark, DISABLED_EventBusVsSignals2) {
+    const size_t deliveries = bench_size("FOOTBALL_BENCH_DELIVERIES", 10'000'000);
+    PlayerScoredEventData event("John", 1);
+
+    for (size_t subscribers : {1, 10, 1000}) {
+        const size_t events = deliveries / subscribers;
+        long long sink = 0;
+
+        boost::signals2::signal<void(EventData*)> signal;
+        for (size_t i = 0; i < subscribers; ++i) {
+            signal.connect([&](EventData* e) {
+                if (auto ps = dynamic_cast<PlayerScoredEventData*>(e)) sink += ps->goals_scored_so_far;
+            });
+        }
+        auto t0 = bench_clock::now();
+        for (size_t i = 0; i < events; ++i) signal(&event);
+        double signal_rate = events / elapsed_sec(t0);
+
+        EventBus bus;
+        std::vector<EventBus::Subscription> subscriptions;
+        for (size_t i = 0; i < subscribers; ++i) {
+            subscriptions.push_back(
+                bus.subscribe<PlayerScoredEventData>([&](const PlayerScoredEventData& e) { sink += e.goals_scored_so_far; }));
+        }
+        t0 = bench_clock::now();
+        for (size_t i = 0; i < events; ++i) bus.emit(event);
+        double bus_rate = events / elapsed_sec(t0);
+
+        EXPECT_EQ(sink, static_cast<long long>(2 * events * subscribers));
+        std::cout << subscribers << " subscribers: signals2 " << static_cast<long>(signal_rate)
+                  << " events/sec, EventBus " << static_cast<long>(bus_rate) << " events/sec\n";
+    }
+}
+
+TEST(FootballBenchmark, DISABLED_AsyncDispatchLatency) {
+    const size_t events = bench_size("FOOTBALL_BENCH_EVENTS", 1'000'000);
+    struct TimedEvent {
+        bench_clock::time_point posted;
+    };
+
+    for (size_t batch : {1, 64, 1024}) {
+        std::vector<double> latencies_us;
+        latencies_us.reserve(events);
+        auto t0 = bench_clock::now();
+        {
+            AsyncDispatcher<TimedEvent> dispatcher(8192, 1, batch);
+            dispatcher.subscribe([&](const TimedEvent& e) {
+                latencies_us.push_back(std::chrono::duration<double, std::micro>(bench_clock::now() - e.posted).count());
+            });
+            for (size_t i = 0; i < events; ++i) dispatcher.post(TimedEvent{bench_clock::now()});
+        }
+        double seconds = elapsed_sec(t0);
+        std::sort(latencies_us.begin(), latencies_us.end());
+        std::cout << "batch " << batch << ": " << static_cast<long>(events / seconds) << " events/sec, latency p50 "
+                  << latencies_us[events / 2] << " us, p99 " << latencies_us[events * 99 / 100] << " us\n";
+    }
+}
+
+TEST(FootballBenchmark, DISABLED_StatisticsTenMillionEvents) {
+    const size_t events = bench_size("FOOTBALL_BENCH_EVENTS", 10'000'000);
+    constexpr uint32_t players = 10'000, teams = 500, matches = 100'000;
+
+    std::vector<ScoreRecord> log;
+    log.reserve(events);
+    std::mt19937 rng(1);
+    for (size_t i = 0; i < events; ++i) {
+        uint32_t p = rng() % players;
+        log.push_back({p, p % teams, static_cast<uint32_t>(i * matches / events)});
+    }
+
+    ScoreStatistics live, bulk;
+    for (uint32_t p = 0; p < players; ++p) {
+        live.player_id(numbered("player", p), p % teams);
+        bulk.player_id(numbered("player", p), p % teams);
+    }
+
+    auto t0 = bench_clock::now();
+    for (const auto& r : log) live.record(r);
+    double incremental = elapsed_sec(t0);
+
+    t0 = bench_clock::now();
+    bulk.replay(log);
+    double replay = elapsed_sec(t0);
+
+    EXPECT_EQ(live.top(10), bulk.top(10));
+    std::cout << events << " events: incremental " << static_cast<long>(events / incremental)
+              << " events/sec, bulk replay " << static_cast<long>(events / replay) << " events/sec\n";
+}
+
+TEST(FootballBenchmark, DISABLED_EventLogWriteAndReplay) {
+    const size_t events = bench_size("FOOTBALL_BENCH_EVENTS", 10'000'000);
+    const std::string path = testing::TempDir() + "football_bench.log";
+    constexpr uint32_t players = 10'000;
+
+    std::vector<PlayerScoredEventData> pool;
+    for (uint32_t p = 0; p < players; ++p) pool.emplace_back(numbered("player", p), 1, p % 500, 0);
+
+    std::remove(path.c_str()); // the writer would continue a leftover log
+    std::remove((path + ".names").c_str());
+    auto t0 = bench_clock::now();
+    {
+        EventLogWriter writer(path);
+        for (size_t i = 0; i < events; ++i) writer.append(pool[i % players]);
+    }
+    double write = elapsed_sec(t0);
+
+    EventBus bus;
+    long long goals = 0;
+    auto subscription = bus.subscribe<PlayerScoredEventData>([&](const PlayerScoredEventData& e) { goals += e.goals_scored_so_far; });
+    t0 = bench_clock::now();
+    EventLogReader reader(path);
+    reader.replay(bus);
+    double replay = elapsed_sec(t0);
+
+    EXPECT_EQ(goals, static_cast<long long>(events));
+    std::cout << events << " events: write " << static_cast<long>(events / write)
+              << " events/sec, replay " << static_cast<long>(events / replay) << " events/sec\n";
+    std::remove(path.c_str());
+    std::remove((path + ".names").c_str());
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -1,54 +1,331 @@
 #include <iostream>
 #include <string>
 #include <memory>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <fstream>
+#include <cstdint>
+#include <cstdlib>
+#include <memory_resource>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <system_error>
+#include <exception>
+#include <stdexcept>
+#include <limits>
+#include <cstring>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
 #include "boost/lexical_cast.hpp"
 #include <gtest/gtest.h>
+#include "bench.h"
 
 
+enum class LogLevel : uint8_t { info, warn, off };
+
 struct Logger {
     virtual ~Logger() = default;
     virtual void info(const std::string& s) = 0;
     virtual void warn(const std::string& s) = 0;
+
+    // Callers check enabled() before building the message, so a disabled
+    // level costs one relaxed load and no formatting.
+    bool enabled(LogLevel l) const { return l >= level.load(std::memory_order_relaxed); }
+    void set_level(LogLevel l) { level.store(l, std::memory_order_relaxed); }
+
+protected:
+    explicit Logger(LogLevel l = LogLevel::info) : level{ l } { }
+
+private:
+    std::atomic<LogLevel> level;
 };
 
 struct ConsoleLogger : Logger
 {
     void info(const std::string& s) override {
+        if (!enabled(LogLevel::info)) return;
         std::cout << "INFO: " << s << std::endl;
     }
     void warn(const std::string& s) override {
+        if (!enabled(LogLevel::warn)) return;
         std::cout << "WARNNING!!!" << s << std::endl;
     }
 };
 
 // Pimpl
+// Its level gates message formatting at the call site; impl's own level
+// still filters what is finally written. A registry logger is shared, so
+// its level applies to every account holding that logger id.
 struct OptionalLogger : Logger {
     std::shared_ptr<Logger> impl;
     static std::shared_ptr<Logger> no_logging;
     OptionalLogger(const std::shared_ptr<Logger>& logger) : impl { logger } { };
+    // Hides Logger::enabled: without an impl every level is off, and
+    // assigning impl later turns logging on at the current level.
+    bool enabled(LogLevel l) const { return impl && Logger::enabled(l); }
     virtual void info(const std::string& s) override {
-        if (impl) impl->info(s); // null check
+        if (enabled(LogLevel::info)) impl->info(s); // null check
     }
     virtual void warn(const std::string& s) override {
-        if (impl) impl->warn(s); // null check
+        if (enabled(LogLevel::warn)) impl->warn(s); // null check
     }
 };
 
 std::shared_ptr<Logger> OptionalLogger::no_logging{};
 
+// Owns one OptionalLogger per registered logger, so accounts can refer to a
+// logger by id instead of allocating their own OptionalLogger.
+struct LoggerRegistry {
+    using id_type = std::uint32_t;
+    static constexpr id_type no_logging = 0;
+
+    LoggerRegistry() { loggers.emplace_back(OptionalLogger::no_logging); }
+
+    id_type add(const std::shared_ptr<Logger>& logger) {
+        loggers.emplace_back(logger);
+        return static_cast<id_type>(loggers.size() - 1);
+    }
+
+    // Non-owning handle: aliasing an empty shared_ptr means copying it
+    // neither allocates nor touches a reference count.
+    std::shared_ptr<OptionalLogger> get(id_type id) {
+        return std::shared_ptr<OptionalLogger>(std::shared_ptr<void>{}, &loggers.at(id));
+    }
+
+private:
+    std::deque<OptionalLogger> loggers; // deque keeps element addresses stable
+};
+
+struct BankAccount;
+
+// Append-only write-ahead log of deposits. Each record carries the balance
+// after the deposit, so replay only keeps the last record per account.
+// Record layout: [u32 checksum][u16 name length][i32 amount][i32 balance][name]
+// append() blocks until its record is on disk; a commit thread batches the
+// records of concurrent depositors into one write + fdatasync per window.
+// A failed write or fdatasync fails every append of that batch and every
+// later one, since the file no longer says which records reached disk.
+class TransactionJournal {
+    static constexpr size_t header_size = 4 + 2 + 4 + 4;
+
+    int fd = -1;
+    std::chrono::microseconds commit_window;
+    std::mutex mtx;
+    std::condition_variable pending_cv, durable_cv;
+    std::string pending;           // records not yet handed to the commit thread
+    uint64_t appended_seq = 0;     // last sequence number handed out
+    uint64_t durable_seq = 0;      // last sequence number known to be on disk
+    bool stopping = false;
+    std::exception_ptr failure;    // first write/fdatasync error, rethrown by append()
+    std::unordered_map<std::string, int> recovered; // balances replayed at startup
+    std::thread committer;
+
+    static uint32_t checksum(const char* data, size_t size) {
+        uint32_t h = 2166136261u; // FNV-1a
+        for (size_t i = 0; i < size; ++i) {
+            h = (h ^ static_cast<unsigned char>(data[i])) * 16777619u;
+        }
+        return h;
+    }
+
+    // Parses whole, checksummed records and stops at the first torn one.
+    template <typename F>
+    static size_t scan(const std::string& bytes, F&& on_record) {
+        size_t pos = 0;
+        while (bytes.size() - pos >= header_size) {
+            uint32_t sum;
+            uint16_t len;
+            int32_t amount, balance;
+            std::memcpy(&sum, bytes.data() + pos, 4);
+            std::memcpy(&len, bytes.data() + pos + 4, 2);
+            std::memcpy(&amount, bytes.data() + pos + 6, 4);
+            std::memcpy(&balance, bytes.data() + pos + 10, 4);
+            if (bytes.size() - pos - header_size < len) break;
+            if (checksum(bytes.data() + pos + 4, header_size - 4 + len) != sum) break;
+            on_record(std::string_view(bytes.data() + pos + header_size, len), amount, balance);
+            pos += header_size + len;
+        }
+        return pos;
+    }
+
+    static std::string read_file(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    void commit_loop() {
+        std::unique_lock lock(mtx);
+        for (;;) {
+            pending_cv.wait(lock, [this] { return stopping || !pending.empty(); });
+            if (pending.empty() && stopping) return;
+            if (commit_window.count() > 0 && !stopping) {
+                // let more depositors join this batch
+                pending_cv.wait_for(lock, commit_window, [this] { return stopping; });
+            }
+            std::string batch;
+            batch.swap(pending);
+            uint64_t batch_seq = appended_seq;
+            lock.unlock();
+
+            int error = 0;
+            for (size_t off = 0; off < batch.size() && !error;) {
+                ssize_t n = ::write(fd, batch.data() + off, batch.size() - off);
+                if (n < 0) {
+                    if (errno != EINTR) error = errno;
+                    continue;
+                }
+                off += static_cast<size_t>(n);
+            }
+            const char* what = "journal write";
+            if (!error && ::fdatasync(fd) != 0) {
+                error = errno;
+                what = "journal fdatasync";
+            }
+
+            lock.lock();
+            if (error) {
+                failure = std::make_exception_ptr(std::system_error(error, std::generic_category(), what));
+                pending.clear();
+            } else {
+                durable_seq = batch_seq;
+            }
+            durable_cv.notify_all();
+        }
+    }
+
+public:
+    explicit TransactionJournal(const std::string& path,
+                                std::chrono::microseconds commit_window = std::chrono::microseconds{0})
+        : commit_window(commit_window) {
+        // drop a torn tail left by a crash so new records follow valid ones
+        size_t valid = scan(read_file(path), [this](std::string_view name, int, int balance) {
+            recovered[std::string(name)] = balance;
+        });
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd < 0) throw std::system_error(errno, std::generic_category(), "open " + path);
+        if (::ftruncate(fd, static_cast<off_t>(valid)) != 0) {
+            ::close(fd);
+            throw std::system_error(errno, std::generic_category(), "truncate " + path);
+        }
+        committer = std::thread(&TransactionJournal::commit_loop, this);
+    }
+
+    TransactionJournal(const TransactionJournal&) = delete;
+    TransactionJournal& operator=(const TransactionJournal&) = delete;
+
+    ~TransactionJournal() {
+        {
+            std::lock_guard lock(mtx);
+            stopping = true;
+        }
+        pending_cv.notify_one();
+        committer.join();
+        ::close(fd);
+    }
+
+    // Throws std::length_error for names the u16 length field can't hold,
+    // and std::system_error once the journal has failed to reach disk.
+    void append(std::string_view name, int amount, int balance) {
+        if (name.size() > std::numeric_limits<uint16_t>::max()) {
+            throw std::length_error("journal: account name longer than 65535 bytes");
+        }
+        char header[header_size];
+        uint16_t len = static_cast<uint16_t>(name.size());
+        std::memcpy(header + 4, &len, 2);
+        std::memcpy(header + 6, &amount, 4);
+        std::memcpy(header + 10, &balance, 4);
+
+        std::unique_lock lock(mtx);
+        if (failure) std::rethrow_exception(failure);
+        size_t start = pending.size();
+        pending.append(header, header_size).append(name);
+        uint32_t sum = checksum(pending.data() + start + 4, header_size - 4 + len);
+        std::memcpy(pending.data() + start, &sum, 4);
+        uint64_t seq = ++appended_seq;
+        pending_cv.notify_one();
+        durable_cv.wait(lock, [&] { return durable_seq >= seq || failure; });
+        if (durable_seq < seq) std::rethrow_exception(failure);
+    }
+
+    // Journals the account's deposits from now on. If the journal already
+    // held records for it, its balance is restored to the last one.
+    void attach(BankAccount& account);
+
+    // Latest journaled balance of every account.
+    static std::unordered_map<std::string, int> replay(const std::string& path) {
+        std::unordered_map<std::string, int> balances;
+        scan(read_file(path), [&](std::string_view name, int, int balance) {
+            balances[std::string(name)] = balance;
+        });
+        return balances;
+    }
+};
+
 struct BankAccount {
     std::string name;
     int balance = 0;
     std::shared_ptr<OptionalLogger> logger;
+    TransactionJournal* journal = nullptr; // optional, not owned
+    uint32_t log_every = 1;                // keep 1 in log_every deposit messages
+    uint32_t log_counter = 0;              // deposit messages seen by the sampler
     BankAccount(const std::string& name, int balance, const std::shared_ptr<Logger>& logger = OptionalLogger::no_logging)
         : name{ name },
           balance{ balance },
           logger { std::make_shared<OptionalLogger>(logger) } { };
+    // shared mode: the registry must outlive the account
+    BankAccount(const std::string& name, int balance, LoggerRegistry& registry,
+                LoggerRegistry::id_type logger_id = LoggerRegistry::no_logging)
+        : name{ name },
+          balance{ balance },
+          logger { registry.get(logger_id) } { };
+    // Rate-limited sampling, per account even when the logger is shared.
+    void set_log_sampling(uint32_t every) { log_every = every; log_counter = 0; }
     void deposit(int amount);
 };
 
+// Bulk construction: every account is placed in one arena-backed deque and
+// shares a registry logger, so opening N accounts costs O(1) allocations for
+// short names. The deque never moves accounts, so references returned by
+// open() stay valid, and growing it leaves no dead buffers in the arena.
+class BankAccountArena {
+    std::pmr::monotonic_buffer_resource arena;
+    std::pmr::deque<BankAccount> accounts{ &arena };
+    LoggerRegistry& registry;
+
+public:
+    // capacity sizes the arena's first block; more accounts still fit
+    explicit BankAccountArena(LoggerRegistry& registry, size_t capacity = 0)
+        : arena(std::max<size_t>(capacity, 1) * sizeof(BankAccount)), registry(registry) { }
+
+    BankAccount& open(const std::string& name, int balance,
+                      LoggerRegistry::id_type logger_id = LoggerRegistry::no_logging) {
+        return accounts.emplace_back(name, balance, registry, logger_id);
+    }
+
+    size_t size() const { return accounts.size(); }
+    BankAccount& operator[](size_t i) { return accounts[i]; }
+};
+
+void TransactionJournal::attach(BankAccount& account) {
+    std::lock_guard lock(mtx);
+    if (auto it = recovered.find(account.name); it != recovered.end()) account.balance = it->second;
+    account.journal = this;
+}
+
 void BankAccount::deposit(int amount) {
     balance += amount;
+    if (journal) journal->append(name, amount, balance);
+    if (!logger->enabled(LogLevel::info)) return;
+    if (log_every > 1 && log_counter++ % log_every != 0) return;
     logger->info("Deposited $" + boost::lexical_cast<std::string>(amount)
                 + " to " + name + ", balance is now $"
                 + boost::lexical_cast<std::string>(balance));
@@ -132,6 +409,341 @@ TEST_F(BankTest, MultipleBankAccounts) {
     EXPECT_EQ(output.str(), "INFO: Deposited $500 to John Doe, balance is now $1500\n");
 }
 
+TEST_F(BankTest, RegistryLoggerSharedAcrossAccounts) {
+    LoggerRegistry registry;
+    auto console = std::make_shared<ConsoleLogger>();
+    auto id = registry.add(console);
+    BankAccount account1{"John Doe", 1000, registry, id};
+    BankAccount account2{"Jane Doe", 2000, registry};
+
+    account1.deposit(500);
+    account2.deposit(1000);
+
+    EXPECT_EQ(account1.logger.use_count(), 0); // non-owning
+    EXPECT_EQ(console.use_count(), 2);         // held by the registry only
+    EXPECT_EQ(account2.balance, 3000);
+    EXPECT_EQ(output.str(), "INFO: Deposited $500 to John Doe, balance is now $1500\n");
+}
+
+TEST_F(BankTest, ArenaBulkOpen) {
+    LoggerRegistry registry;
+    auto id = registry.add(std::make_shared<ConsoleLogger>());
+    BankAccountArena arena{registry, 3};
+    for (int i = 0; i < 3; ++i) {
+        arena.open("acct" + std::to_string(i), i * 100, i == 1 ? id : LoggerRegistry::no_logging);
+    }
+
+    ASSERT_EQ(arena.size(), size_t(3));
+    arena[0].deposit(1);
+    arena[1].deposit(1);
+
+    EXPECT_EQ(arena[0].balance, 1);
+    EXPECT_EQ(arena[2].balance, 200);
+    EXPECT_EQ(output.str(), "INFO: Deposited $1 to acct1, balance is now $101\n");
+}
+
+TEST_F(BankTest, ArenaReferencesSurviveGrowth) {
+    LoggerRegistry registry;
+    BankAccountArena arena{registry};
+    BankAccount& first = arena.open("first", 0);
+    for (int i = 0; i < 10'000; ++i) arena.open("acct", i);
+
+    first.deposit(7);
+    EXPECT_EQ(&first, &arena[0]);
+    EXPECT_EQ(arena[0].balance, 7);
+    EXPECT_EQ(arena[10'000].balance, 9'999);
+}
+
+TEST_F(BankTest, InfoLevelFilteredAtRuntime) {
+    auto logger = std::make_shared<ConsoleLogger>();
+    BankAccount account{"John Doe", 1000, logger};
+
+    account.logger->set_level(LogLevel::warn); // filtered before formatting
+    account.deposit(500);
+    logger->set_level(LogLevel::warn);         // filtered at the console
+    logger->info("dropped");
+    logger->warn("kept");
+    account.logger->set_level(LogLevel::info);
+    logger->set_level(LogLevel::info);
+    account.deposit(1);
+
+    EXPECT_EQ(account.balance, 1501);
+    EXPECT_EQ(output.str(), "WARNNING!!!kept\n"
+                            "INFO: Deposited $1 to John Doe, balance is now $1501\n");
+}
+
+TEST_F(BankTest, OptionalLoggerWithoutImplIsOff) {
+    OptionalLogger logger{nullptr};
+    EXPECT_FALSE(logger.enabled(LogLevel::info));
+    EXPECT_FALSE(logger.enabled(LogLevel::warn));
+}
+
+TEST_F(BankTest, DepositMessagesSampledPerAccount) {
+    LoggerRegistry registry;
+    auto id = registry.add(std::make_shared<ConsoleLogger>());
+    BankAccount john{"John", 0, registry, id};
+    BankAccount jane{"Jane", 0, registry, id};
+    john.set_log_sampling(3);
+
+    for (int i = 0; i < 4; ++i) john.deposit(1);
+    for (int i = 0; i < 2; ++i) jane.deposit(1); // same logger, not sampled
+
+    EXPECT_EQ(john.balance, 4);
+    EXPECT_EQ(output.str(), "INFO: Deposited $1 to John, balance is now $1\n"
+                            "INFO: Deposited $1 to John, balance is now $4\n"
+                            "INFO: Deposited $1 to Jane, balance is now $1\n"
+                            "INFO: Deposited $1 to Jane, balance is now $2\n");
+}
+
+TEST_F(BankTest, OptionalLoggerChecksItsOwnLevel) {
+    OptionalLogger logger{std::make_shared<ConsoleLogger>()};
+    logger.set_level(LogLevel::warn);
+    logger.info("dropped");
+    logger.warn("kept");
+
+    EXPECT_EQ(output.str(), "WARNNING!!!kept\n");
+}
+
+TEST_F(BankTest, OptionalLoggerImplAssignedLater) {
+    OptionalLogger logger{nullptr};
+    logger.impl = std::make_shared<ConsoleLogger>();
+
+    EXPECT_TRUE(logger.enabled(LogLevel::info));
+    logger.info("now on");
+    EXPECT_EQ(output.str(), "INFO: now on\n");
+}
+
+class JournalTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path = testing::TempDir() + "bank_journal_" + std::to_string(::getpid()) + ".wal";
+        std::remove(path.c_str());
+    }
+
+    void TearDown() override {
+        std::remove(path.c_str());
+    }
+
+    std::string path;
+};
+
+TEST_F(JournalTest, ReplayRebuildsBalances) {
+    {
+        TransactionJournal journal{path};
+        BankAccount john{"John Doe", 1000};
+        BankAccount jane{"Jane Doe", 2000};
+        john.journal = jane.journal = &journal;
+        john.deposit(500);
+        jane.deposit(100);
+        john.deposit(-200);
+    }
+
+    auto balances = TransactionJournal::replay(path);
+    ASSERT_EQ(balances.size(), size_t(2));
+    EXPECT_EQ(balances["John Doe"], 1300);
+    EXPECT_EQ(balances["Jane Doe"], 2100);
+}
+
+TEST_F(JournalTest, TornTailIsIgnoredAndTruncated) {
+    {
+        TransactionJournal journal{path};
+        journal.append("John Doe", 500, 1500);
+    }
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::app);
+        out.write("\x01\x02\x03\x04\x05\x06\x07", 7); // half a record
+    }
+    EXPECT_EQ(TransactionJournal::replay(path).at("John Doe"), 1500);
+
+    {
+        TransactionJournal journal{path};
+        journal.append("John Doe", 1, 1501);
+    }
+    EXPECT_EQ(TransactionJournal::replay(path).at("John Doe"), 1501);
+}
+
+TEST_F(JournalTest, CrashMidBatchKeepsAcknowledgedDeposits) {
+    constexpr int threads = 4;
+    // acknowledged deposits per account, visible to the parent after the kill
+    auto* acked = static_cast<std::atomic<int>*>(::mmap(nullptr, sizeof(std::atomic<int>) * threads,
+        PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    ASSERT_NE(acked, MAP_FAILED);
+    for (int i = 0; i < threads; ++i) new (&acked[i]) std::atomic<int>(0);
+
+    pid_t pid = ::fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        TransactionJournal journal{path, std::chrono::microseconds{200}};
+        std::vector<std::thread> depositors;
+        for (int i = 0; i < threads; ++i) {
+            depositors.emplace_back([&, i] {
+                BankAccount account{"acct" + std::to_string(i), 0};
+                account.journal = &journal;
+                for (;;) {
+                    account.deposit(1);
+                    acked[i].fetch_add(1);
+                }
+            });
+        }
+        while (acked[threads - 1].load() < 200) std::this_thread::yield();
+        ::kill(::getpid(), SIGKILL);
+    }
+
+    int status = 0;
+    ::waitpid(pid, &status, 0);
+    ASSERT_TRUE(WIFSIGNALED(status));
+
+    auto balances = TransactionJournal::replay(path);
+    for (int i = 0; i < threads; ++i) {
+        // every acknowledged deposit survived; at most one batch more did
+        EXPECT_GE(balances["acct" + std::to_string(i)], acked[i].load());
+    }
+    ::munmap(acked, sizeof(std::atomic<int>) * threads);
+}
+
+TEST_F(JournalTest, AttachRestoresJournaledBalance) {
+    {
+        TransactionJournal journal{path};
+        BankAccount john{"John Doe", 1000};
+        journal.attach(john);
+        john.deposit(500);
+    }
+
+    TransactionJournal journal{path};
+    BankAccount john{"John Doe", 0};
+    BankAccount jane{"Jane Doe", 2000};
+    journal.attach(john);
+    journal.attach(jane);
+    EXPECT_EQ(john.balance, 1500);
+    EXPECT_EQ(jane.balance, 2000); // nothing journaled yet
+    john.deposit(1);
+    EXPECT_EQ(john.balance, 1501);
+}
+
+TEST_F(JournalTest, OversizedNameIsRejected) {
+    TransactionJournal journal{path};
+    EXPECT_THROW(journal.append(std::string(65536, 'x'), 1, 1), std::length_error);
+    journal.append(std::string(65535, 'x'), 1, 1);
+    journal.append("John Doe", 2, 2);
+
+    auto balances = TransactionJournal::replay(path);
+    EXPECT_EQ(balances.size(), size_t(2));
+    EXPECT_EQ(balances.at("John Doe"), 2);
+}
+
+TEST_F(JournalTest, FailedWriteFailsAppendAndLaterOnes) {
+    // a 64-byte file size limit makes the third 22-byte record fail with EFBIG
+    rlimit old_limit;
+    ASSERT_EQ(::getrlimit(RLIMIT_FSIZE, &old_limit), 0);
+    auto old_handler = ::signal(SIGXFSZ, SIG_IGN);
+    rlimit small = old_limit;
+    small.rlim_cur = 64;
+    ASSERT_EQ(::setrlimit(RLIMIT_FSIZE, &small), 0);
+    {
+        TransactionJournal journal{path};
+        journal.append("acct0000", 1, 1);
+        journal.append("acct0000", 1, 2);
+        EXPECT_THROW(journal.append("acct0000", 1, 3), std::system_error);
+        EXPECT_THROW(journal.append("acct0000", 1, 4), std::system_error);
+    }
+    ::setrlimit(RLIMIT_FSIZE, &old_limit);
+    ::signal(SIGXFSZ, old_handler);
+
+    EXPECT_EQ(TransactionJournal::replay(path).at("acct0000"), 2);
+}
+
+// Benchmarks are disabled by default, run them with:
+//   ./bank --gtest_also_run_disabled_tests --gtest_filter='BankBenchmark.*'
+// BANK_BENCH_ACCOUNTS overrides the number of accounts (default 10M).
+TEST(BankBenchmark, DISABLED_ConstructAccountsMakeShared) {
+    const size_t n = bench_size("BANK_BENCH_ACCOUNTS", 10'000'000);
+    auto logger = std::make_shared<ConsoleLogger>();
+
+    long rss0 = current_rss_kb();
+    auto t0 = bench_clock::now();
+    std::vector<BankAccount> accounts;
+    accounts.reserve(n);
+    for (size_t i = 0; i < n; ++i) accounts.emplace_back("acct", 0, logger);
+    std::cout << n << " accounts, make_shared per account: " << elapsed_ms(t0) << " ms, "
+              << (current_rss_kb() - rss0) / 1024 << " MB RSS\n";
+}
+
+TEST(BankBenchmark, DISABLED_ConstructAccountsArena) {
+    const size_t n = bench_size("BANK_BENCH_ACCOUNTS", 10'000'000);
+    LoggerRegistry registry;
+    auto id = registry.add(std::make_shared<ConsoleLogger>());
+
+    long rss0 = current_rss_kb();
+    auto t0 = bench_clock::now();
+    BankAccountArena arena{registry, n};
+    for (size_t i = 0; i < n; ++i) arena.open("acct", 0, id);
+    std::cout << n << " accounts, registry + arena: " << elapsed_ms(t0) << " ms, "
+              << (current_rss_kb() - rss0) / 1024 << " MB RSS\n";
+}
+
+TEST(BankBenchmark, DISABLED_DisabledLogCall) {
+    const size_t n = bench_size("BANK_BENCH_DEPOSITS", 10'000'000);
+    auto ns_per_op = [n](bench_clock::time_point t0) { return elapsed_ms(t0) * 1e6 / n; };
+
+    BankAccount quiet{"John Doe", 0};
+    auto t0 = bench_clock::now();
+    for (size_t i = 0; i < n; ++i) quiet.deposit(1);
+    std::cout << "deposit, no_logging:           " << ns_per_op(t0) << " ns\n";
+
+    // what every deposit paid before levels: format, then drop in OptionalLogger
+    t0 = bench_clock::now();
+    for (size_t i = 0; i < n; ++i) {
+        quiet.balance += 1;
+        quiet.logger->info("Deposited $" + boost::lexical_cast<std::string>(1)
+                           + " to " + quiet.name + ", balance is now $"
+                           + boost::lexical_cast<std::string>(quiet.balance));
+    }
+    std::cout << "deposit, format + null logger: " << ns_per_op(t0) << " ns\n";
+
+    BankAccount muted{"John Doe", 0, std::make_shared<ConsoleLogger>()};
+    muted.logger->set_level(LogLevel::warn);
+    t0 = bench_clock::now();
+    for (size_t i = 0; i < n; ++i) muted.deposit(1);
+    std::cout << "deposit, info disabled:        " << ns_per_op(t0) << " ns\n";
+
+    std::ostringstream sink;
+    auto* old = std::cout.rdbuf(sink.rdbuf());
+    BankAccount sampled{"John Doe", 0, std::make_shared<ConsoleLogger>()};
+    sampled.set_log_sampling(1000);
+    t0 = bench_clock::now();
+    for (size_t i = 0; i < n; ++i) sampled.deposit(1);
+    double sampled_ns = ns_per_op(t0);
+    std::cout.rdbuf(old);
+    std::cout << "deposit, sampled 1 in 1000:    " << sampled_ns << " ns\n";
+}
+
+TEST(BankBenchmark, DISABLED_GroupCommitDeposits) {
+    const size_t per_thread = bench_size("BANK_BENCH_DEPOSITS", 2'000);
+    const size_t threads = bench_size("BANK_BENCH_THREADS", 8);
+    const std::string path = testing::TempDir() + "bank_bench.wal";
+
+    for (int window_us : {0, 100, 1000, 5000}) {
+        std::remove(path.c_str());
+        auto t0 = bench_clock::now();
+        {
+            TransactionJournal journal{path, std::chrono::microseconds{window_us}};
+            std::vector<std::thread> depositors;
+            for (size_t t = 0; t < threads; ++t) {
+                depositors.emplace_back([&, t] {
+                    BankAccount account{"acct" + std::to_string(t), 0};
+                    account.journal = &journal;
+                    for (size_t i = 0; i < per_thread; ++i) account.deposit(1);
+                });
+            }
+            for (auto& d : depositors) d.join();
+        }
+        double ms = elapsed_ms(t0);
+        std::cout << "window " << window_us << " us: "
+                  << static_cast<long>(threads * per_thread / (ms / 1000)) << " deposits/sec\n";
+    }
+    std::remove(path.c_str());
+}
+
 int main(int argc, char **argv) {
     testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();